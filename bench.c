@@ -0,0 +1,392 @@
+/* cc bench.c -o dwmbench -lX11 -lXtst -lXrandr, run by make bench */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/Xatom.h>
+#include <X11/keysym.h>
+#include <X11/extensions/XTest.h>
+#include <X11/extensions/record.h>
+#include <X11/extensions/Xrandr.h>
+
+#define NWIN 500
+#define MAXOPS 4096
+
+static Display *d, *rd;          /* ours, and the one XRecord reports on */
+static Window root, probe;
+static int probex;
+static int dwmpid;
+static XID dwmbase;              /* resource base of dwm's connection */
+static unsigned long dwmreqs;    /* requests dwm sent, counted by XRecord */
+static double lat[MAXOPS];
+static int nlat;
+
+static void
+die(const char *msg)
+{
+	fprintf(stderr, "%s\n", msg);
+	exit(1);
+}
+
+/* windows may be gone by the time a request reaches them, and a server
+ * without a resizable screen fails the hotplug run only */
+static int
+xerror(Display *dpy, XErrorEvent *ee)
+{
+	return 0;
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void
+recorded(XPointer p, XRecordInterceptData *r)
+{
+	if (r->category == XRecordFromClient && r->id_base == dwmbase)
+		dwmreqs++;
+	XRecordFreeData(r);
+}
+
+/* the next event on w: every arrange sends the other bench windows their
+ * ConfigureNotify, those are read and dropped here, as left in the queue
+ * each wait would scan them all */
+static void
+nextevent(Window w, XEvent *e)
+{
+	do {
+		XRecordProcessReplies(rd);
+		XNextEvent(d, e);
+	} while (e->xany.window != w);
+}
+
+/* wait for what arrives on w, dwm answering us included */
+static void
+waitfor(Window w, int type)
+{
+	XEvent e;
+
+	do
+		nextevent(w, &e);
+	while (e.type != type);
+}
+
+/* returns once dwm has handled everything sent before: a move of the
+ * probe window is answered by a synthetic ConfigureNotify from dwm */
+static void
+wmsync(void)
+{
+	XEvent e;
+
+	XMoveWindow(d, probe, probex ^= 1, 0);
+	do
+		nextevent(probe, &e);
+	while (e.type != ConfigureNotify || !e.xconfigure.send_event);
+}
+
+/* whether dwm runs a dwm.so, which openplug() maps from a copy in /tmp */
+static int
+plugged(void)
+{
+	char path[64], buf[512];
+	FILE *f;
+	int r = 0;
+
+	snprintf(path, sizeof path, "/proc/%d/maps", dwmpid);
+	if ((f = fopen(path, "r"))) {
+		while (!r && fgets(buf, sizeof buf, f))
+			r = strstr(buf, "/tmp/dwm-") != NULL;
+		fclose(f);
+	}
+	return r;
+}
+
+static Window
+window(const char *name)
+{
+	Window w;
+
+	w = XCreateSimpleWindow(d, root, 0, 0, 200, 100, 0, 0, 0);
+	XSelectInput(d, w, StructureNotifyMask);
+	XStoreName(d, w, name);
+	return w;
+}
+
+static void
+key(KeySym mod, KeySym sym)
+{
+	KeyCode m = XKeysymToKeycode(d, mod), k = XKeysymToKeycode(d, sym);
+
+	XTestFakeKeyEvent(d, m, True, 0);
+	XTestFakeKeyEvent(d, k, True, 0);
+	XTestFakeKeyEvent(d, k, False, 0);
+	XTestFakeKeyEvent(d, m, False, 0);
+}
+
+static void
+usage(long *cpu, long *rss)
+{
+	char path[64], buf[1024], *p;
+	unsigned long ut, st;
+	FILE *f;
+
+	*cpu = *rss = 0;
+	snprintf(path, sizeof path, "/proc/%d/stat", dwmpid);
+	if ((f = fopen(path, "r"))) {
+		/* utime and stime are fields 14 and 15, after the comm in () */
+		if (fgets(buf, sizeof buf, f) && (p = strrchr(buf, ')'))
+		    && sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+		              &ut, &st) == 2)
+			*cpu = (ut + st) * 1000 / sysconf(_SC_CLK_TCK);
+		fclose(f);
+	}
+	snprintf(path, sizeof path, "/proc/%d/status", dwmpid);
+	if ((f = fopen(path, "r"))) {
+		while (fgets(buf, sizeof buf, f))
+			if (sscanf(buf, "VmRSS: %ld", rss) == 1)
+				break;
+		fclose(f);
+	}
+}
+
+static int
+cmp(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static long cpu0;
+static unsigned long reqs0;
+
+static void
+begin(void)
+{
+	long rss;
+
+	wmsync();
+	nlat = 0;
+	usage(&cpu0, &rss);
+	reqs0 = dwmreqs;
+}
+
+static void
+op(double start)
+{
+	if (nlat < MAXOPS)
+		lat[nlat++] = now() - start;
+}
+
+static void
+report(const char *name)
+{
+	long cpu, rss;
+
+	wmsync();
+	usage(&cpu, &rss);
+	qsort(lat, nlat, sizeof *lat, cmp);
+	printf("%-12s %5d %10.0f %10.0f %10.1f %9ld %9ld\n", name, nlat,
+	       nlat ? lat[nlat / 2] : 0, nlat ? lat[nlat * 99 / 100] : 0,
+	       nlat ? (double)(dwmreqs - reqs0) / nlat : 0, cpu - cpu0, rss);
+}
+
+static void
+mapunmap(void)
+{
+	Window w[NWIN];
+	double t;
+	int i;
+
+	begin();
+	for (i = 0; i < NWIN; i++) {
+		w[i] = window("bench");
+		t = now();
+		XMapWindow(d, w[i]);
+		waitfor(w[i], MapNotify);
+		op(t);
+	}
+	for (i = 0; i < NWIN; i++) {
+		t = now();
+		XDestroyWindow(d, w[i]);
+		wmsync();
+		op(t);
+	}
+	report("map/unmap");
+}
+
+static void
+titles(void)
+{
+	char name[32];
+	Window w;
+	double t;
+	int i, j;
+
+	w = window("title");
+	XMapWindow(d, w);
+	waitfor(w, MapNotify);
+	begin();
+	for (i = 0; i < 200; i++) {
+		t = now();
+		for (j = 0; j < 10; j++) {
+			snprintf(name, sizeof name, "title %d", i * 10 + j);
+			XStoreName(d, w, name);
+		}
+		wmsync();
+		op(t);
+	}
+	report("titles");
+	XDestroyWindow(d, w);
+}
+
+static void
+tags(void)
+{
+	static const KeySym t[] = { XK_1, XK_2, XK_3, XK_4 };
+	Window w[40];
+	double s;
+	int i;
+
+	for (i = 0; i < 40; i++) {
+		w[i] = window("tags");
+		XMapWindow(d, w[i]);
+		waitfor(w[i], MapNotify);
+		if (i % 10 == 9) { /* ten windows on each of the four tags */
+			key(XK_Super_L, t[(i / 10 + 1) % 4]);
+			wmsync();
+		}
+	}
+	begin();
+	for (i = 0; i < 1000; i++) {
+		s = now();
+		key(XK_Super_L, t[i % 4]);
+		wmsync();
+		op(s);
+	}
+	report("tags");
+	key(XK_Super_L, XK_1);
+	for (i = 0; i < 40; i++)
+		XDestroyWindow(d, w[i]);
+}
+
+static void
+mfact(void)
+{
+	Window w[8];
+	double s;
+	int i;
+
+	for (i = 0; i < 8; i++) {
+		w[i] = window("mfact");
+		XMapWindow(d, w[i]);
+		waitfor(w[i], MapNotify);
+	}
+	key(XK_Super_L, XK_t); /* tiled, where mfact matters */
+	begin();
+	for (i = 0; i < 400; i++) {
+		s = now();
+		key(XK_Super_L, i / 20 % 2 ? XK_l : XK_h);
+		wmsync();
+		op(s);
+	}
+	report("mfact");
+	for (i = 0; i < 8; i++)
+		XDestroyWindow(d, w[i]);
+}
+
+/* resize the root window through RandR, which dwm sees as a monitor change */
+static void
+hotplug(void)
+{
+	int i, w = DisplayWidth(d, DefaultScreen(d)), h = DisplayHeight(d, DefaultScreen(d));
+	double s;
+
+	begin();
+	for (i = 0; i < 50; i++) {
+		s = now();
+		XRRSetScreenSize(d, root, i % 2 ? w : w / 2, i % 2 ? h : h / 2,
+		                 DisplayWidthMM(d, 0), DisplayHeightMM(d, 0));
+		wmsync();
+		op(s);
+	}
+	report("hotplug");
+}
+
+int
+main(int argc, char *argv[])
+{
+	XRecordClientSpec spec = XRecordAllClients;
+	XRecordRange *range;
+	XRecordContext ctx;
+	Atom check, type;
+	int i, fmt, major, minor;
+	unsigned long n, after;
+	unsigned char *p = NULL;
+
+	if (argc != 2 && argc != 3)
+		die("usage: dwmbench pid-of-dwm [reload-seconds]");
+	dwmpid = atoi(argv[1]);
+	/* with a reload pending, measure nothing until dwm.so is in */
+	for (i = 0; argc == 3 && !plugged(); i++) {
+		if (i >= atoi(argv[2]) * 10)
+			die("dwmbench: dwm did not swap in a dwm.so");
+		usleep(100000);
+	}
+	if (!(d = XOpenDisplay(NULL)) || !(rd = XOpenDisplay(NULL)))
+		die("dwmbench: cannot open display");
+	if (!XRecordQueryVersion(d, &major, &minor))
+		die("dwmbench: no RECORD extension");
+	XSetErrorHandler(xerror);
+	root = DefaultRootWindow(d);
+
+	/* dwm is the client owning _NET_SUPPORTING_WM_CHECK */
+	check = XInternAtom(d, "_NET_SUPPORTING_WM_CHECK", False);
+	for (i = 0; i < 50 && !p; i++)
+		if (XGetWindowProperty(d, root, check, 0, 1, False, XA_WINDOW, &type, &fmt,
+		                       &n, &after, &p) != Success || !n) {
+			if (p)
+				XFree(p);
+			p = NULL;
+			usleep(100000);
+		}
+	if (!p)
+		die("dwmbench: no window manager running");
+	dwmbase = *(Window *)p & ~0x1fffff; /* the server's default client mask */
+	XFree(p);
+
+	range = XRecordAllocRange();
+	range->core_requests.first = 1;
+	range->core_requests.last = 127;
+	ctx = XRecordCreateContext(d, 0, &spec, 1, &range, 1);
+	XSync(d, False);
+	XRecordEnableContextAsync(rd, ctx, recorded, NULL);
+
+	probe = window("probe");
+	XMapWindow(d, probe);
+	waitfor(probe, MapNotify);
+
+	printf("%-12s %5s %10s %10s %10s %9s %9s\n", "scenario", "ops",
+	       "p50 us", "p99 us", "dwm req/op", "cpu ms", "rss kB");
+	mapunmap();
+	titles();
+	tags();
+	mfact();
+	hotplug();
+
+	XRecordDisableContext(d, ctx);
+	XRecordFreeContext(d, ctx);
+	XFree(range);
+	XCloseDisplay(rd);
+	XCloseDisplay(d);
+	return 0;
+}
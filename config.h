@@ -3,8 +3,11 @@
 /* appearance */
 static const unsigned int borderpx  = 1;        /* border pixel of windows */
 static const unsigned int snap      = 32;       /* snap pixel */
+static const unsigned int refreshrate = 60;     /* frames per second of mouse moves and resizes */
 static const int showbar            = 1;        /* 0 means no bar */
 static const int topbar             = 1;        /* 0 means bottom bar */
+static const unsigned int shelfslot = 80;       /* bar width of each minimized window */
+static const char clockfmt[]        = "%d/%m/%Y %H-%M-%S"; /* strftime(3) format of the bar clock */
 static const char *fonts[]          = { "monospace:size=10" };
 static const char dmenufont[]       = "monospace:size=10";
 static const char col_gray1[]       = "#222222";
@@ -54,6 +57,9 @@ static const Layout layouts[] = {
 /* helper for spawning shell commands in the pre dwm-5.0 fashion */
 #define SHCMD(cmd) { .v = (const char*[]){ "/bin/sh", "-c", cmd, NULL } }
 
+/* source tree reloads() rebuilds dwm and dwm.so in, with make */
+static const char plugdir[] = "/home/sony/dwm";
+
 /* commands */
 static char dmenumon[2] = "0"; /* component of dmenucmd, manipulated in spawn() */
 static const char *dmenucmd[] = { "dmenu_run", "-m", dmenumon, "-fn", dmenufont, "-nb", col_gray1, "-nf", col_gray3, "-sb", col_cyan, "-sf", col_gray4, NULL };
@@ -98,6 +104,7 @@ static const Key keys[] = {
     TAGKEYS(                        XK_8,                      7)
     TAGKEYS(                        XK_9,                      8)
     { MODKEY|ShiftMask,             XK_q,      &quit,           {0} },
+    { MODKEY|ShiftMask,             XK_r,      &restart,        {0} },
 };
 
 /* button definitions */
@@ -107,6 +114,7 @@ static const Button buttons[] = {
     { ClkLtSymbol,          0,              Button1,        &setlayout,      {0} },
     { ClkLtSymbol,          0,              Button3,        &setlayout,      {.v = &layouts[2]} },
     { ClkWinTitle,          0,              Button2,        &zoom,           {0} },
+    { ClkShelf,             0,              Button1,        &unshelve,       {0} },
     { ClkStatusText,        0,              Button2,        &spawn,          {.v = termcmd } },
     { ClkClientWin,         MODKEY,         Button1,        &movemouse,      {0} },
     { ClkClientWin,         MODKEY,         Button2,        &togglefloating, {0} },
@@ -14,6 +14,22 @@ X11LIB = /usr/X11R6/lib
 XINERAMALIBS  = -lXinerama
 XINERAMAFLAGS = -DXINERAMA
 
+# RandR 1.5 monitors, kept by output name across hotplugs so only the changed
+# ones are rearranged, instead of Xinerama screens; uncomment for it
+#XRANDRLIBS  = -lXrandr
+#XRANDRFLAGS = -DXRANDR
+
+# sync after every bar blit, resize and configure request instead of flushing
+# once per event batch, uncomment for A/B comparisons with the old behaviour
+#SYNCFLAGS = -DEAGERSYNC
+
+# time every handler, arrange, drawbar and restack, written as a Chrome trace
+# to /tmp/dwm-trace.json on SIGUSR1
+#TRACEFLAGS = -DTRACE
+
+# xcb, for pipelining requests whose replies are needed together
+XCBLIBS = -lX11-xcb -lxcb
+
 # freetype
 FREETYPELIBS = -lfontconfig -lXft
 FREETYPEINC = /usr/include/freetype2
@@ -23,12 +39,12 @@ FREETYPEINC = /usr/include/freetype2
 
 # includes and libs
 INCS = -I${X11INC} -I${FREETYPEINC}
-LIBS = -L${X11LIB} -lX11 ${XINERAMALIBS} ${FREETYPELIBS}
+LIBS = -L${X11LIB} -lX11 -lXext ${XCBLIBS} ${XINERAMALIBS} ${XRANDRLIBS} ${FREETYPELIBS}
 
 # flags
-CPPFLAGS = -D_DEFAULT_SOURCE -D_BSD_SOURCE -D_XOPEN_SOURCE=700L -DVERSION=\"${VERSION}\" ${XINERAMAFLAGS}
+CPPFLAGS = -D_DEFAULT_SOURCE -D_BSD_SOURCE -D_XOPEN_SOURCE=700L -DVERSION=\"${VERSION}\" ${XINERAMAFLAGS} ${XRANDRFLAGS} ${SYNCFLAGS} ${TRACEFLAGS}
 #CFLAGS   = -g -std=c99 -pedantic -Wall -O0 ${INCS} ${CPPFLAGS}
-CFLAGS   = -std=c99 -pedantic -Wall -Wno-deprecated-declarations -Os ${INCS} ${CPPFLAGS} -fPIC -rdynamic -g -e
+CFLAGS   = -std=c99 -pedantic -Wall -Wno-deprecated-declarations -Os ${INCS} ${CPPFLAGS} -fPIC -rdynamic -g
 LDFLAGS  = ${LIBS}
 
 # Solaris
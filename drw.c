@@ -47,16 +47,13 @@ utf8decode(const char *s_in, long *u, int *err)
 }
 
 Drw *
-drw_create(Display *dpy, int screen, Window root, unsigned int w, unsigned int h)
+drw_create(Display *dpy, int screen, Window root)
 {
     Drw *drw = ecalloc(1, sizeof(Drw));
 
     drw->dpy = dpy;
     drw->screen = screen;
     drw->root = root;
-    drw->w = w;
-    drw->h = h;
-    drw->drawable = XCreatePixmap(dpy, root, w, h, DefaultDepth(dpy, screen));
     drw->gc = XCreateGC(dpy, root, 0, NULL);
     XSetLineAttributes(dpy, drw->gc, 1, LineSolid, CapButt, JoinMiter);
 
@@ -64,25 +61,59 @@ drw_create(Display *dpy, int screen, Window root, unsigned int w, unsigned int h
 }
 
 void
-drw_resize(Drw *drw, unsigned int w, unsigned int h)
+drw_free(Drw *drw)
 {
-    if (!drw)
+    XFreeGC(drw->dpy, drw->gc);
+    drw_fontset_free(drw->fonts);
+    free(drw);
+}
+
+Buf *
+drw_buf_create(Drw *drw, unsigned int w, unsigned int h)
+{
+    Buf *buf = ecalloc(1, sizeof(Buf));
+
+    buf->w = w;
+    buf->h = h;
+    buf->drawable = XCreatePixmap(drw->dpy, drw->root, w, h, DefaultDepth(drw->dpy, drw->screen));
+    buf->xftdraw = XftDrawCreate(drw->dpy, buf->drawable, DefaultVisual(drw->dpy, drw->screen),
+				 DefaultColormap(drw->dpy, drw->screen));
+    return buf;
+}
+
+void
+drw_buf_resize(Drw *drw, Buf *buf, unsigned int w, unsigned int h)
+{
+    if (!buf || (buf->w == w && buf->h == h))
 	return;
 
-    drw->w = w;
-    drw->h = h;
-    if (drw->drawable)
-	XFreePixmap(drw->dpy, drw->drawable);
-    drw->drawable = XCreatePixmap(drw->dpy, drw->root, w, h, DefaultDepth(drw->dpy, drw->screen));
+    buf->w = w;
+    buf->h = h;
+    XFreePixmap(drw->dpy, buf->drawable);
+    buf->drawable = XCreatePixmap(drw->dpy, drw->root, w, h, DefaultDepth(drw->dpy, drw->screen));
+    XftDrawChange(buf->xftdraw, buf->drawable);
+    if (drw->xftdraw == buf->xftdraw)
+	drw->drawable = buf->drawable;
 }
 
 void
-drw_free(Drw *drw)
+drw_buf_free(Drw *drw, Buf *buf)
 {
-    XFreePixmap(drw->dpy, drw->drawable);
-    XFreeGC(drw->dpy, drw->gc);
-    drw_fontset_free(drw->fonts);
-    free(drw);
+    if (!buf)
+	return;
+    if (drw->xftdraw == buf->xftdraw)
+	drw_setbuf(drw, NULL);
+    XftDrawDestroy(buf->xftdraw);
+    XFreePixmap(drw->dpy, buf->drawable);
+    free(buf);
+}
+
+/* Selects the buffer the drawing functions and drw_map work on. */
+void
+drw_setbuf(Drw *drw, Buf *buf)
+{
+    drw->drawable = buf ? buf->drawable : None;
+    drw->xftdraw = buf ? buf->xftdraw : NULL;
 }
 
 /* This function is an implementation detail. Library users should use
@@ -136,9 +167,68 @@ xfont_free(Fnt *font)
     if (font->pattern)
 	FcPatternDestroy(font->pattern);
     XftFontClose(font->dpy, font->xfont);
+    free(font->latin1);
+    free(font->glyphs);
     free(font);
 }
 
+static Gly *
+glyphslot(Fnt *set, long codepoint)
+{
+    unsigned int i, hash;
+
+    if (codepoint < 256 && codepoint >= 0)
+	return &set->latin1[codepoint];
+    hash = (unsigned int)codepoint;
+    hash = ((hash >> 16) ^ hash) * 0x21F0AAAD;
+    hash = ((hash >> 15) ^ hash) * 0xD35A2D97;
+    for (i = (hash ^ (hash >> 15)) & (set->glyphcap - 1);
+	 set->glyphs[i].font && set->glyphs[i].codepoint != codepoint;
+	 i = (i + 1) & (set->glyphcap - 1))
+	; /* linear probing */
+    return &set->glyphs[i];
+}
+
+/* Returns which font of the set covers codepoint and its advance, asking Xft
+ * only the first time a codepoint is seen. NULL if no loaded font has it. */
+static Gly *
+glyphfind(Drw *drw, long codepoint)
+{
+    Fnt *set = drw->fonts, *curfont;
+    Gly *g, *old;
+    XGlyphInfo ext;
+    unsigned int i, oldcap;
+
+    if (!set->latin1)
+	set->latin1 = ecalloc(256, sizeof(Gly));
+    if (set->nglyphs * 2 >= set->glyphcap) {
+	old = set->glyphs;
+	oldcap = set->glyphcap;
+	set->glyphcap = oldcap ? oldcap * 2 : 64;
+	set->glyphs = ecalloc(set->glyphcap, sizeof(Gly));
+	for (i = 0; i < oldcap; i++)
+	    if (old[i].font)
+		*glyphslot(set, old[i].codepoint) = old[i];
+	free(old);
+    }
+    if ((g = glyphslot(set, codepoint))->font)
+	return g;
+
+    for (curfont = set; curfont; curfont = curfont->next)
+	if (XftCharExists(drw->dpy, curfont->xfont, codepoint))
+	    break;
+    if (!curfont)
+	return NULL;
+    g->codepoint = codepoint;
+    g->font = curfont;
+    g->index = XftCharIndex(drw->dpy, curfont->xfont, codepoint);
+    XftGlyphExtents(drw->dpy, curfont->xfont, &g->index, 1, &ext);
+    g->w = ext.xOff;
+    if (codepoint >= 256 || codepoint < 0)
+	set->nglyphs++;
+    return g;
+}
+
 Fnt*
 drw_fontset_create(Drw* drw, const char *fonts[], size_t fontcount)
 {
@@ -235,12 +325,13 @@ drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lp
     FcPattern *fcpattern;
     FcPattern *match;
     XftResult result;
+    Gly *g;
     int charexists = 0, overflow = 0;
     /* keep track of a couple codepoints for which we have no match. */
     static unsigned int nomatches[128], ellipsis_width, invalid_width;
     static const char invalid[] = "�";
 
-    if (!drw || (render && (!drw->scheme || !w)) || !text || !drw->fonts)
+    if (!drw || (render && (!drw->scheme || !w || !drw->xftdraw)) || !text || !drw->fonts)
 	return 0;
 
     if (!render) {
@@ -250,9 +341,7 @@ drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lp
 	XFillRectangle(drw->dpy, drw->drawable, drw->gc, x, y, w, h);
 	if (w < lpad)
 	    return x + w;
-	d = XftDrawCreate(drw->dpy, drw->drawable,
-			  DefaultVisual(drw->dpy, drw->screen),
-			  DefaultColormap(drw->dpy, drw->screen));
+	d = drw->xftdraw;
 	x += lpad;
 	w -= lpad;
     }
@@ -268,10 +357,24 @@ drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lp
 	nextfont = NULL;
 	while (*text) {
 	    utf8charlen = utf8decode(text, &utf8codepoint, &utf8err);
-	    for (curfont = drw->fonts; curfont; curfont = curfont->next) {
+	    /* charexists is forced after a failed fallback search, the first
+	     * font then draws its missing glyph; invalid sequences are measured
+	     * as raw bytes. Neither goes through the glyph cache. */
+	    if (!charexists && !utf8err) {
+		g = glyphfind(drw, utf8codepoint);
+		charexists = g != NULL;
+		curfont = g ? g->font : NULL;
+	    } else {
+		g = NULL;
+		curfont = drw->fonts;
+	    }
+	    for (; curfont; curfont = curfont->next) {
 		charexists = charexists || XftCharExists(drw->dpy, curfont->xfont, utf8codepoint);
 		if (charexists) {
-		    drw_font_getexts(curfont, text, utf8charlen, &tmpw, NULL);
+		    if (g)
+			tmpw = g->w;
+		    else
+			drw_font_getexts(curfont, text, utf8charlen, &tmpw, NULL);
 		    if (ew + ellipsis_width <= w) {
 			/* keep track where the ellipsis still fits */
 			ellipsis_x = x + ew;
@@ -376,12 +479,67 @@ drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lp
 	    }
 	}
     }
-    if (d)
-	XftDrawDestroy(d);
-
     return x + (render ? w : 0);
 }
 
+/* Shapes text into run using the loaded fontset. Unlike drw_text no fallback
+ * fonts are searched for; codepoints no loaded font covers use the first
+ * font's missing glyph. Text beyond RUNLEN glyphs is dropped. */
+void
+drw_run_shape(Drw *drw, Run *run, const char *text)
+{
+    Gly *g, missing = { 0 };
+    XGlyphInfo ext;
+    long utf8codepoint;
+    int utf8err;
+
+    run->len = run->w = 0;
+    if (!drw || !drw->fonts || !text)
+	return;
+    while (*text && run->len < RUNLEN) {
+	text += utf8decode(text, &utf8codepoint, &utf8err);
+	if (!(g = glyphfind(drw, utf8codepoint))) {
+	    g = &missing;
+	    g->font = drw->fonts;
+	    g->index = XftCharIndex(drw->dpy, g->font->xfont, utf8codepoint);
+	    XftGlyphExtents(drw->dpy, g->font->xfont, &g->index, 1, &ext);
+	    g->w = ext.xOff;
+	}
+	run->specs[run->len].font = g->font->xfont;
+	run->specs[run->len].glyph = g->index;
+	run->specs[run->len].x = run->w;
+	run->w += g->w;
+	run->len++;
+    }
+}
+
+/* Draws a run shaped by drw_run_shape, clipped to whole glyphs within w. */
+int
+drw_run(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lpad, const Run *run, int invert)
+{
+    XftGlyphFontSpec specs[RUNLEN];
+    XftFont *f;
+    unsigned int i, adv;
+
+    if (!drw || !drw->scheme || !w || !run)
+	return 0;
+    XSetForeground(drw->dpy, drw->gc, drw->scheme[invert ? ColFg : ColBg].pixel);
+    XFillRectangle(drw->dpy, drw->drawable, drw->gc, x, y, w, h);
+    if (w < lpad)
+	return x + w;
+    for (i = 0; i < run->len; i++) {
+	adv = i + 1 < run->len ? run->specs[i + 1].x : run->w;
+	if (adv > w - lpad)
+	    break;
+	f = run->specs[i].font;
+	specs[i] = run->specs[i];
+	specs[i].x += x + lpad;
+	specs[i].y = y + (h - (f->ascent + f->descent)) / 2 + f->ascent;
+    }
+    XftDrawGlyphFontSpec(drw->xftdraw, &drw->scheme[invert ? ColBg : ColFg], specs, i);
+    return x + w;
+}
+
 void
 drw_map(Drw *drw, Window win, int x, int y, unsigned int w, unsigned int h)
 {
@@ -389,7 +547,7 @@ drw_map(Drw *drw, Window win, int x, int y, unsigned int w, unsigned int h)
 	return;
 
     XCopyArea(drw->dpy, drw->drawable, win, drw->gc, x, y, w, h, x, y);
-    XSync(drw->dpy, False);
+    XSYNC(drw->dpy);
 }
 
 unsigned int
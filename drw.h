@@ -4,39 +4,71 @@ typedef struct {
   Cursor cursor;
 } Cur;
 
+typedef struct Gly Gly;
 typedef struct Fnt {
   Display *dpy;
   unsigned int h;
   XftFont *xfont;
   FcPattern *pattern;
   struct Fnt *next;
+  Gly *latin1;               /* codepoint cache of the set it heads, */
+  Gly *glyphs;               /* flat below 256, open-addressed above */
+  unsigned int nglyphs, glyphcap;
 } Fnt;
 
+struct Gly {
+  long codepoint;
+  Fnt *font;                   /* first font of the set covering it, NULL if unset */
+  FT_UInt index;
+  unsigned int w;              /* advance in pixels */
+};
+
 enum { ColFg, ColBg, ColBorder }; /* Clr scheme index */
 typedef XftColor Clr;
 
+/* a string shaped once into positioned glyphs, redrawn without font lookups */
+#define RUNLEN 256
+typedef struct {
+  XftGlyphFontSpec specs[RUNLEN]; /* x relative to the run start, y unset */
+  unsigned int len;               /* glyphs in specs */
+  unsigned int w;                 /* total advance in pixels */
+} Run;
+
+/* an offscreen pixmap with the XftDraw rendering into it */
 typedef struct {
   unsigned int w, h;
+  Drawable drawable;
+  XftDraw *xftdraw;
+} Buf;
+
+typedef struct {
   Display *dpy;
   int screen;
   Window root;
-  Drawable drawable;
+  Drawable drawable;           /* of the Buf selected by drw_setbuf */
+  XftDraw *xftdraw;
   GC gc;
   Clr *scheme;
   Fnt *fonts;
 } Drw;
 
 /* Drawable abstraction */
-Drw *drw_create(Display *dpy, int screen, Window win, unsigned int w, unsigned int h);
-void drw_resize(Drw *drw, unsigned int w, unsigned int h);
+Drw *drw_create(Display *dpy, int screen, Window win);
 void drw_free(Drw *drw);
 
+/* Buf abstraction */
+Buf *drw_buf_create(Drw *drw, unsigned int w, unsigned int h);
+void drw_buf_resize(Drw *drw, Buf *buf, unsigned int w, unsigned int h);
+void drw_buf_free(Drw *drw, Buf *buf);
+void drw_setbuf(Drw *drw, Buf *buf);
+
 /* Fnt abstraction */
 Fnt *drw_fontset_create(Drw* drw, const char *fonts[], size_t fontcount);
 void drw_fontset_free(Fnt* set);
 unsigned int drw_fontset_getwidth(Drw *drw, const char *text);
 unsigned int drw_fontset_getwidth_clamp(Drw *drw, const char *text, unsigned int n);
 void drw_font_getexts(Fnt *font, const char *text, unsigned int len, unsigned int *w, unsigned int *h);
+void drw_run_shape(Drw *drw, Run *run, const char *text);
 
 /* Colorscheme abstraction */
 void drw_clr_create(Drw *drw, Clr *dest, const char *clrname);
@@ -53,6 +85,7 @@ void drw_setscheme(Drw *drw, Clr *scm);
 /* Drawing functions */
 void drw_rect(Drw *drw, int x, int y, unsigned int w, unsigned int h, int filled, int invert);
 int drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lpad, const char *text, int invert);
+int drw_run(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lpad, const Run *run, int invert);
 
 /* Map functions */
 void drw_map(Drw *drw, Window win, int x, int y, unsigned int w, unsigned int h);
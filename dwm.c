@@ -28,34 +28,55 @@
 #include <signal.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
 #include <sys/types.h>
+#include <sys/un.h>
 #include <sys/wait.h>
+#include <limits.h>
 #include <X11/cursorfont.h>
 #include <X11/keysym.h>
 #include <X11/Xatom.h>
 #include <X11/Xlib.h>
+#include <X11/Xlib-xcb.h>
 #include <X11/Xproto.h>
 #include <X11/Xutil.h>
+#include <X11/extensions/sync.h>
 #include <dlfcn.h>
 #include <link.h>
 #ifdef XINERAMA
 #include <X11/extensions/Xinerama.h>
 #endif /* XINERAMA */
+#ifdef XRANDR
+#include <X11/extensions/Xrandr.h>
+#endif /* XRANDR */
 #include <X11/Xft/Xft.h>
 
 #include "drw.h"
 #include "util.h"
 
 /* macros */
+#define BATCHLEN                256 /* events dispatched per batch by run() */
 #define BUTTONMASK              (ButtonPressMask|ButtonReleaseMask)
 #define CLEANMASK(mask)         (mask & ~(plug->numlockmask|LockMask) & (ShiftMask|ControlMask|Mod1Mask|Mod2Mask|Mod3Mask|Mod4Mask|Mod5Mask))
 #define INTERSECT(x,y,w,h,m)    (MAX(0, MIN((x)+(w),(m)->wx+(m)->ww) - MAX((x),(m)->wx)) \
 				 * MAX(0, MIN((y)+(h),(m)->wy+(m)->wh) - MAX((y),(m)->wy)))
-#define ISVISIBLE(C)            ((C->tags & C->mon->tagset[C->mon->seltags]))
+#define ARRANGECACHE            4
+#define COLD(C)                 (&(*plug).cold[(C)->cold])
+#define POOLSLAB                64
+#define RULEWORDS               ((LENGTH(rules) + 64) / 64)
+#define ISVISIBLE(C)            ((C->tags & C->mon->tagset[C->mon->seltags]) && !C->isminimized)
 #define MOUSEMASK               (BUTTONMASK|PointerMotionMask)
+#define STATUSSEGS              8   /* status segments, 0 is the root WM_NAME */
+#define SYNCTIMEOUT             100 /* ms a drag waits for a client to repaint */
 #define WIDTH(X)                ((X)->w + 2 * (X)->bw)
 #define HEIGHT(X)               ((X)->h + 2 * (X)->bw)
 #define TAGMASK                 ((1 << LENGTH(tags)) - 1)
@@ -66,10 +87,16 @@ enum { CurNormal, CurResize, CurMove, CurLast }; /* cursor */
 enum { SchemeNorm, SchemeSel }; /* color schemes */
 enum { NetSupported, NetWMName, NetWMState, NetWMCheck,
 	NetWMFullscreen, NetActiveWindow, NetWMWindowType,
-	NetWMWindowTypeDialog, NetClientList, NetLast }; /* EWMH atoms */
+	NetWMWindowTypeDialog, NetClientList, NetWMSyncRequest,
+	NetWMSyncRequestCounter, NetLast }; /* EWMH atoms */
 enum { WMProtocols, WMDelete, WMState, WMTakeFocus, WMLast }; /* default atoms */
-enum { ClkTagBar, ClkLtSymbol, ClkStatusText, ClkWinTitle,
+enum { ClkTagBar, ClkLtSymbol, ClkShelf, ClkStatusText, ClkWinTitle,
 	ClkClientWin, ClkRootWin, ClkLast }; /* clicks */
+enum { BarTags, BarLtSymbol, BarShelf, BarTitle, BarStatus }; /* bar segments */
+enum { PropNetWMName, PropWMName, PropTransient, PropClass, PropNetWMState,
+	PropNetWMWindowType, PropNormalHints, PropHints, PropLast }; /* fetchprops() */
+enum { CtlReload = 'r', CtlQuit = 'q', CtlTrace = 't', CtlStatus = 's',
+	CtlView = 'v', CtlTag = 'g', CtlLayout = 'l' }; /* control messages, see ctlmsg() */
 
 typedef union {
 	int i;
@@ -88,24 +115,30 @@ typedef struct {
 
 typedef struct Monitor Monitor;
 typedef struct Client Client;
+/* What layouts, focus and the list walks touch lives in Client, one cache
+ * line on LP64; the rest lives in a ClientCold record reached by COLD(). */
 struct Client {
-	char name[256];
-	float mina, maxa;
-	int x, y, w, h;
-	int oldx, oldy, oldw, oldh;
-
-	int maximx, maximy, maximw, maximh;
-  
-	int basew, baseh, incw, inch, maxw, maxh, minw, minh, hintsvalid;
-	int bw, oldbw;
-	unsigned int tags;
-	int isfixed, isfloating, isurgent, neverfocus, oldstate, isfullscreen, isminimized;
 	Client *next;
 	Client *snext;
 	Monitor *mon;
 	Window win;
+	int x, y, w, h;
+	unsigned int tags;
+	int bw;
+	unsigned int isfixed : 1, isfloating : 1, isurgent : 1, neverfocus : 1,
+	             oldstate : 1, isfullscreen : 1, isminimized : 1, hintsvalid : 1,
+	             focusgrab : 1; /* click to focus is grabbed, see grabbuttons() */
+	unsigned int cold;    /* index of its ClientCold in Plug.cold */
 };
 
+typedef struct {
+	char name[256];
+	float mina, maxa;
+	int oldx, oldy, oldw, oldh, oldbw;
+	unsigned int shelfslot; /* in its monitor's shelf while minimized */
+	int basew, baseh, incw, inch, maxw, maxh, minw, minh;
+} ClientCold;
+
 typedef struct {
 	unsigned int mod;
 	KeySym keysym;
@@ -113,11 +146,69 @@ typedef struct {
 	const Arg arg;
 } Key;
 
+#ifdef TRACE
+#define TRACEFILE    "/tmp/dwm-trace.json"
+#define TRACERING    4096
+#define TRACEBUCKETS 256
+enum { TraceArrange = LASTEvent, TraceDrawbar, TraceRestack, TraceLast };
+typedef struct {
+	uint64_t start, dur;  /* ns */
+	uint32_t what;        /* event type or Trace* */
+	uint32_t requests;    /* X requests issued meanwhile */
+} TraceRec;
+
+typedef struct {
+	uint64_t count[TraceLast], requests[TraceLast];
+	uint32_t hist[TraceLast][TRACEBUCKETS]; /* see tracebucket() */
+	TraceRec ring[TRACERING];
+	unsigned int head;
+} Trace;
+
+#define TRACED(W, CALL) do { \
+	uint64_t t0_ = tracenow(); \
+	unsigned long r0_ = NextRequest((*plug).dpy); \
+	CALL; \
+	tracerecord((W), t0_, r0_); \
+} while (0)
+#else
+#define TRACED(W, CALL) CALL
+#endif
+
+typedef struct {
+	unsigned int code, mask; /* keycode and CLEANMASK()ed modifiers */
+	unsigned int key;        /* index into keys[] + 1, 0 if unused */
+} KeyBind;
+
+typedef struct {
+	uint32_t *v;             /* code or button << 16 | modifiers, sorted */
+	unsigned int n;
+} GrabSet;
+
 typedef struct {
 	const char *symbol;
 	void (**arrange)(Monitor *);
 } Layout;
 
+typedef struct {
+	Client *c;
+	int x, y, w, h;
+} Place;
+
+typedef struct {      /* everything a layout result depends on */
+	const Layout *lt;
+	unsigned int tagset, clientgen;
+	float mfact;
+	int nmaster;
+	int wx, wy, ww, wh;
+} ArrangeKey;
+
+typedef struct {
+	ArrangeKey key;
+	Place *place;
+	unsigned int n, cap;
+	char ltsymbol[16];
+} LayoutCache;
+
 struct Monitor {
 	char ltsymbol[16];
 	float mfact;
@@ -131,12 +222,40 @@ struct Monitor {
 	unsigned int tagset[2];
 	int showbar;
 	int topbar;
+	struct {              /* what the bar shows, to find damaged segments */
+		unsigned int dirty;  /* 1 << Bar* of segments to redraw */
+		int ww;
+		unsigned int occ, urg, tagset, seltags;
+		char lt[16];
+		unsigned int ltw;
+		int stw;             /* width of the status segment */
+		int shelfw;
+		unsigned int shelfgen;
+		unsigned int statusgen;
+		const Client *sel;
+		char title[256];
+		int titlestate;
+		int queued;          /* drawbar() deferred to the end of the batch */
+	} bar;
 	Client *clients;
 	Client *sel;
 	Client *stack;
 	Monitor *next;
 	Window barwin;
+	Buf *barbuf;          /* the bar is drawn here and copied to barwin */
 	const Layout *lt[2];
+	LayoutCache lcache[ARRANGECACHE]; /* recent results, see arrangemon() */
+	unsigned int lnext;   /* lcache entry to replace next */
+	ArrangeKey arranged;  /* of the last arrange() */
+	unsigned int stackgen;
+	Client *stacksel;     /* what its restack() saw */
+	Window *stacked;      /* bar and tiled windows as restack() left them */
+	unsigned int nstacked, stackedcap;
+	Atom output;          /* RandR monitor name, see rrgeom() */
+	Client **shelf;       /* minimized clients by slot, see shelfadd() */
+	unsigned int nshelf, shelfcap;
+	unsigned int shelfgen; /* bumped whenever the shelf changes */
+	int geomdirty;        /* new, moved or resized by the last updategeom() */
 };
 
 typedef struct {
@@ -148,22 +267,87 @@ typedef struct {
 	int monitor;
 } Rule;
 
+/* rules[] compiled by compilerules(): one Aho-Corasick automaton over all
+ * class, instance and title patterns, yielding bitsets of rules */
+#define RULEMEMO 64
+enum { RuleClass, RuleInstance, RuleTitle, RuleLast }; /* pattern fields */
+typedef struct {
+	unsigned char cls[256];   /* byte -> alphabet class, 0 if in no pattern */
+	unsigned int ncls, nstates, nw;
+	unsigned int *delta;      /* nstates * ncls transitions */
+	uint64_t *out;            /* per state, RuleLast bitsets of nw words */
+	uint64_t *has;            /* RuleLast bitsets of rules setting the field */
+	struct {
+		char class[64], instance[64];
+		int used;
+	} memo[RULEMEMO];         /* candidates by (class, instance) */
+	uint64_t *memobits;       /* RULEMEMO bitsets */
+} RuleIndex;
+
+#define MAXTIMERS 16
+typedef struct {
+	uint64_t deadline;      /* CLOCK_MONOTONIC, in ms */
+	unsigned int interval;  /* ms between expirations, 0 for one-shot */
+	int id;
+	void (**func)(void);
+} Timer;
+
+typedef struct {
+	Client *c;
+	XSyncCounter counter;   /* _NET_WM_SYNC_REQUEST_COUNTER of c, or None */
+	uint64_t serial;        /* last value requested for counter */
+	uint64_t last;          /* monotime() of the last frame applied */
+	uint64_t sent;          /* monotime() of the last sync request */
+	Time time;              /* server time of the newest motion */
+	int x, y;               /* newest pointer position */
+	int pending, waiting, released;
+	int *snapx, *snapy;     /* sorted left/top edges to snap to, see snapto() */
+	unsigned int nsnap;
+} Drag;
+
+/* Layout a restart keeps, in a memfd passed on as DWM_SNAPSHOT: a
+ * SnapHeader, nmons SnapMons, nclients SnapClients in client list order
+ * and the nclients windows in focus stack order. */
+#define SNAPMAGIC   0x64776d73 /* "smwd" */
+#define SNAPVERSION 2
+typedef struct {
+	uint32_t magic, version, nmons, nclients, selmon;
+} SnapHeader;
+
+typedef struct {
+	float mfact;
+	int32_t nmaster;
+	uint32_t tagset[2], seltags, sellt, lt[2], showbar;
+} SnapMon;
+
+typedef struct {
+	uint32_t win, mon, tags;
+	int32_t x, y, w, h;
+	uint8_t isfloating, isminimized;
+} SnapClient;
+
 /* Rule declarations */
 void __applyrules(Client *c);
+int		 __addtimer(unsigned int ms, unsigned int interval, void (**func)(void));
 int		 __applysizehints(Client *c, int *x, int *y, int *w, int *h, int interact);
 void		 __arrange(Monitor *m);
 void		 __arrangemon(Monitor *m);
 void		 __attach(Client *c);
 void		 __attachstack(Client *c);
 void		 __buttonpress(XEvent *e);
+void		 __builddone(void);
 void		 __checkotherwm(void);
 void		 __cleanup(void);
 void		 __cleanupmon(Monitor *mon);
+void		 __clearmsg(void);
 void		 __clientmessage(XEvent *e);
+void		 __clocktick(void);
+void		 __compilerules(void);
 void		 __configure(Client *c);
 void		 __configurenotify(XEvent *e);
 void		 __configurerequest(XEvent *e);
 Monitor*	 __createmon(void);
+void		 __deltimer(int id);
 void		 __destroynotify(XEvent *e);
 void		 __detach(Client *c);
 void		 __detachstack(Client *c);
@@ -176,6 +360,7 @@ void		 __focus(Client *c);
 void		 __focusin(XEvent *e);
 void		 __focusmon(const Arg *arg);
 void		 __focusstack(const Arg *arg);
+unsigned int	 __gathertiled(Monitor *m);
 Atom		 __getatomprop(Client *c, Atom prop);
 int		 __getrootptr(int *x, int *y);
 long		 __getstate(Window w);
@@ -192,15 +377,21 @@ void		 __monocle(Monitor *m);
 void		 __motionnotify(XEvent *e);
 void		 __movemouse(const Arg *arg);
 Client*		 __nexttiled(Client *c);
+void		 __placeclients(unsigned int n);
+int		 __placehints(Place *p);
 void		 __pop(Client *c);
 void		 __propertynotify(XEvent *e);
 void		 __quit(const Arg *arg);
+void		 __readctl(void);
+void		 __readsock(void);
 Monitor*	 __recttomon(int x, int y, int w, int h);
 void		 __resize(Client *c, int x, int y, int w, int h, int interact);
 void		 __resizeclient(Client *c, int x, int y, int w, int h);
 void		 __resizemouse(const Arg *arg);
 void		 __restack(Monitor *m);
+void		 __restart(const Arg *arg);
 void		 __run(void);
+void		 __runtimers(void);
 void		 __scan(void);
 int		 __sendevent(Client *c, Atom proto);
 void		 __sendmon(Client *c, Monitor *m);
@@ -209,6 +400,7 @@ void		 __setfocus(Client *c);
 void		 __setfullscreen(Client *c, int fullscreen);
 void		 __setlayout(const Arg *arg);
 void		 __setmfact(const Arg *arg);
+void		 __settimer(int id, unsigned int ms);
 void		 __setup(void);
 void		 __seturgent(Client *c, int urg);
 void		 __showhide(Client *c);
@@ -243,23 +435,31 @@ void		 __zoom(const Arg *arg);
 void		 __minimize(Client *c);
 void		 __restore(Client *c);
 void __toggleminimize(const Arg *arg);
+void		 __unshelve(const Arg *arg);
 void __reloads(const Arg *arg);
+void applysymlinks(void);
 
 void		 (*applyrules		)(Client *c);
+int		 (*addtimer		)(unsigned int ms, unsigned int interval, void (**func)(void));
 int		 (*applysizehints	)(Client *c, int *x, int *y, int *w, int *h, int interact);
 void		 (*arrange		)(Monitor *m);
 void		 (*arrangemon		)(Monitor *m);
 void		 (*attach		)(Client *c);
 void		 (*attachstack	)	(Client *c);
 void		 (*buttonpress	)	(XEvent *e);
+void		 (*builddone		)(void);
 void		 (*checkotherwm	)	(void);
 void		 (*cleanup		)(void);
 void		 (*cleanupmon		)(Monitor *mon);
+void		 (*clearmsg		)(void);
 void		 (*clientmessage	)(XEvent *e);
+void		 (*clocktick		)(void);
+void		 (*compilerules		)(void);
 void		 (*configure		)(Client *c);
 void		 (*configurenotify	)(XEvent *e);
 void		 (*configurerequest	)(XEvent *e);
 Monitor*	 (*createmon		)(void);
+void		 (*deltimer		)(int id);
 void		 (*destroynotify	)(XEvent *e);
 void		 (*detach		)(Client *c);
 void		 (*detachstack	)	(Client *c);
@@ -272,6 +472,7 @@ void		 (*focus		)(Client *c);
 void		 (*focusin		)(XEvent *e);
 void		 (*focusmon		)(const Arg *arg);
 void		 (*focusstack		)(const Arg *arg);
+unsigned int	 (*gathertiled		)(Monitor *m);
 Atom		 (*getatomprop	)	(Client *c, Atom prop);
 int		 (*getrootptr		)(int *x, int *y);
 long		 (*getstate		)(Window w);
@@ -288,15 +489,21 @@ void		 (*monocle		)(Monitor *m);
 void		 (*motionnotify	)	(XEvent *e);
 void		 (*movemouse		)(const Arg *arg);
 Client*		 (*nexttiled		)(Client *c);
+void		 (*placeclients		)(unsigned int n);
+int		 (*placehints		)(Place *p);
 void		 (*pop		)	(Client *c);
 void		 (*propertynotify	)(XEvent *e);
 void		 (*quit		)	(const Arg *arg);
+void		 (*readctl		)(void);
+void		 (*readsock		)(void);
 Monitor*	 (*recttomon		)(int x, int y, int w, int h);
 void		 (*resize		)(Client *c, int x, int y, int w, int h, int interact);
 void		 (*resizeclient	)	(Client *c, int x, int y, int w, int h);
 void		 (*resizemouse	)	(const Arg *arg);
 void		 (*restack		)(Monitor *m);
+void		 (*restart		)(const Arg *arg);
 void		 (*run		)	(void);
+void		 (*runtimers		)(void);
 void		 (*scan		)	(void);
 int		 (*sendevent		)(Client *c, Atom proto);
 void		 (*sendmon		)(Client *c, Monitor *m);
@@ -305,6 +512,7 @@ void		 (*setfocus		)(Client *c);
 void		 (*setfullscreen	)(Client *c, int fullscreen);
 void		 (*setlayout		)(const Arg *arg);
 void		 (*setmfact		)(const Arg *arg);
+void		 (*settimer		)(int id, unsigned int ms);
 void		 (*setup		)(void);
 void		 (*seturgent		)(Client *c, int urg);
 void		 (*showhide		)(Client *c);
@@ -339,77 +547,1373 @@ void		 (*zoom		)	(const Arg *arg);
 void		 (*minimize		)(Client *c);
 void		 (*restore		)(Client *c);
 void		 (*toggleminimize	)(const Arg *arg);
+void		 (*unshelve		)(const Arg *arg);
 void		 (*reloads		)(const Arg *arg);
 
-/* variables */
-#include "plug.h"
+/* variables */
+typedef struct Symtab Symtab;
+#include "plug.h"
+
+/* what every build exports as symtab, for reloads() to check and bind */
+struct Symtab {
+	unsigned int abi;       /* PLUGABI */
+	size_t plugsize, monitorsize, clientsize, coldsize;
+	Plug **plug;
+	void (*applysymlinks)(void);
+	const Layout *layouts;
+	unsigned int nlayouts;
+	void **slots;           /* addresses of the function pointers */
+	unsigned int nslots;
+};
+
+Plug *plug;
+
+/* configuration, allows nested code to access above variables */
+#include "config.h"
+
+/* compile-time check if all tags fit into an unsigned int bit array. */
+struct NumTags { char limitexceeded[LENGTH(tags) > 31 ? -1 : 1]; };
+
+/* compile-time check that Client still fits one cache line */
+struct ClientSize { char toolarge[sizeof(Client) > 64 ? -1 : 1]; };
+
+/* function implementations */
+
+/* async-signal-safe: forward the signal to run() through the self-pipe */
+static void
+sigctl(int sig)
+{
+	char c = sig == SIGHUP ? CtlReload : sig == SIGUSR1 ? CtlTrace : CtlQuit;
+	int saved_errno = errno;
+
+	if (write((*plug).ctlpipe[1], &c, 1) == -1)
+		; /* pipe full: run() is already due to wake up */
+	errno = saved_errno;
+}
+
+/* shape the non-empty status segments and the clock (or a message) into
+ * crun, the whole status segment of the bar. drw_run_shape() stops at
+ * RUNLEN glyphs, so the segments get what the clock leaves of them, cut
+ * at a codepoint. */
+static void
+shapestatus(void)
+{
+	char buf[STATUSSEGS * (sizeof *(*plug).stext + 2) + sizeof (*plug).ctext];
+	const char *s;
+	size_t i, n = 0;
+	int room = RUNLEN, g = 0;
+
+	for (s = (*plug).ctext; *s; s++)
+		room -= (*s & 0xc0) != 0x80;
+	for (i = 0; i < STATUSSEGS; i++)
+		if ((*plug).stext[i][0])
+			n += sprintf(buf + n, "%s  ", (*plug).stext[i]);
+	for (i = 0; i < n; i++)
+		if ((buf[i] & 0xc0) != 0x80 && ++g > room)
+			break;
+	strcpy(buf + i, (*plug).ctext);
+	drw_run_shape((*plug).drw, &(*plug).crun, buf);
+	(*plug).statusgen++;
+}
+
+/* format the clock for second t into Plug, reshaping it only on change */
+static int
+updateclock(time_t t)
+{
+	char buf[sizeof (*plug).ctext];
+	struct tm tm;
+
+	if (!localtime_r(&t, &tm) || !strftime(buf, sizeof buf, clockfmt, &tm)
+	    || !strcmp(buf, (*plug).ctext))
+		return 0;
+	memcpy((*plug).ctext, buf, sizeof buf);
+	shapestatus();
+	return 1;
+}
+
+/* show text in place of the clock for ms, until clearmsg() */
+static void
+showmsg(const char *text, unsigned int ms)
+{
+	fprintf(stderr, "dwm: %s\n", text);
+	if ((*plug).msgtimer != -1)
+		deltimer((*plug).msgtimer);
+	(*plug).msgtimer = addtimer(ms, 0, &clearmsg);
+	snprintf((*plug).ctext, sizeof (*plug).ctext, "%s", text);
+	shapestatus();
+	drawbar((*plug).selmon);
+}
+
+/* set status segment i to the n bytes at text, redrawing only if it changed */
+static void
+setstatus(unsigned int i, const char *text, size_t n)
+{
+	char *t = (*plug).stext[i];
+
+	n = MIN(n, sizeof (*plug).stext[i] - 1);
+	if (!strncmp(t, text, n) && !t[n])
+		return;
+	memcpy(t, text, n);
+	t[n] = '\0';
+	shapestatus();
+	drawbar((*plug).selmon);
+}
+
+static uint64_t
+monotime(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+#ifdef TRACE
+/* With -DTRACE every handler call and every arrange(), drawbar() and
+ * restack() is timed: per kind a count, the X requests it issued and a
+ * log-linear latency histogram, plus a ring of the latest calls.
+ * tracedump() writes it all as a Chrome trace (chrome://tracing, Perfetto)
+ * on SIGUSR1. */
+static const char *tracenames[TraceLast] = {
+	[KeyPress] = "KeyPress", [KeyRelease] = "KeyRelease",
+	[ButtonPress] = "ButtonPress", [ButtonRelease] = "ButtonRelease",
+	[MotionNotify] = "MotionNotify", [EnterNotify] = "EnterNotify",
+	[LeaveNotify] = "LeaveNotify", [FocusIn] = "FocusIn",
+	[FocusOut] = "FocusOut", [KeymapNotify] = "KeymapNotify",
+	[Expose] = "Expose", [GraphicsExpose] = "GraphicsExpose",
+	[NoExpose] = "NoExpose", [VisibilityNotify] = "VisibilityNotify",
+	[CreateNotify] = "CreateNotify", [DestroyNotify] = "DestroyNotify",
+	[UnmapNotify] = "UnmapNotify", [MapNotify] = "MapNotify",
+	[MapRequest] = "MapRequest", [ReparentNotify] = "ReparentNotify",
+	[ConfigureNotify] = "ConfigureNotify", [ConfigureRequest] = "ConfigureRequest",
+	[GravityNotify] = "GravityNotify", [ResizeRequest] = "ResizeRequest",
+	[CirculateNotify] = "CirculateNotify", [CirculateRequest] = "CirculateRequest",
+	[PropertyNotify] = "PropertyNotify", [SelectionClear] = "SelectionClear",
+	[SelectionRequest] = "SelectionRequest", [SelectionNotify] = "SelectionNotify",
+	[ColormapNotify] = "ColormapNotify", [ClientMessage] = "ClientMessage",
+	[MappingNotify] = "MappingNotify", [GenericEvent] = "GenericEvent",
+	[TraceArrange] = "arrange", [TraceDrawbar] = "drawbar",
+	[TraceRestack] = "restack",
+};
+
+static uint64_t
+tracenow(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* four buckets per power of two of nanoseconds, exact below 8 */
+static unsigned int
+tracebucket(uint64_t ns)
+{
+	unsigned int msb;
+
+	if (ns < 4)
+		return ns;
+	msb = 63 - __builtin_clzll(ns);
+	return (msb - 1) * 4 + (ns >> (msb - 2) & 3);
+}
+
+/* lower bound in nanoseconds of bucket b */
+static uint64_t
+tracebucketmin(unsigned int b)
+{
+	if (b < 4)
+		return b;
+	return (uint64_t)(4 | b % 4) << (b / 4 - 1);
+}
+
+static void
+tracerecord(unsigned int what, uint64_t start, unsigned long req)
+{
+	Trace *t = &(*plug).trace;
+	TraceRec *r = &t->ring[t->head++ % TRACERING];
+
+	r->start = start;
+	r->dur = tracenow() - start;
+	r->what = what;
+	r->requests = NextRequest((*plug).dpy) - req;
+	t->count[what]++;
+	t->requests[what] += r->requests;
+	t->hist[what][tracebucket(r->dur)]++;
+}
+
+static void
+trarrange(Monitor *m)
+{
+	TRACED(TraceArrange, __arrange(m));
+}
+
+static void
+trdrawbar(Monitor *m)
+{
+	TRACED(TraceDrawbar, __drawbar(m));
+}
+
+static void
+trrestack(Monitor *m)
+{
+	TRACED(TraceRestack, __restack(m));
+}
+
+/* nanoseconds below which fraction q of the calls of kind what took */
+static uint64_t
+tracepercentile(unsigned int what, double q)
+{
+	Trace *t = &(*plug).trace;
+	uint64_t n = 0, want = t->count[what] * q;
+	unsigned int b;
+
+	for (b = 0; b < TRACEBUCKETS; b++)
+		if ((n += t->hist[what][b]) > want)
+			return tracebucketmin(b);
+	return 0;
+}
+
+static void
+tracedump(void)
+{
+	Trace *t = &(*plug).trace;
+	TraceRec *r;
+	unsigned int i, w, b, first = 1;
+	FILE *f;
+
+	if (!(f = fopen(TRACEFILE, "w"))) {
+		showmsg("cannot write " TRACEFILE, 5000);
+		return;
+	}
+	fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", f);
+	i = t->head > TRACERING ? t->head - TRACERING : 0;
+	for (; i < t->head; i++) {
+		r = &t->ring[i % TRACERING];
+		fprintf(f, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":1,"
+		        "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"requests\":%u}}",
+		        first ? "" : ",", tracenames[r->what] ? tracenames[r->what] : "?",
+		        (int)getpid(), r->start / 1e3, r->dur / 1e3, r->requests);
+		first = 0;
+	}
+	fputs("\n],\"dwm\":{", f);
+	for (first = 1, w = 0; w < TraceLast; w++) {
+		if (!t->count[w])
+			continue;
+		fprintf(f, "%s\n\"%s\":{\"count\":%llu,\"requests\":%llu,"
+		        "\"p50_ns\":%llu,\"p99_ns\":%llu,\"hist\":[",
+		        first ? "" : ",", tracenames[w] ? tracenames[w] : "?",
+		        (unsigned long long)t->count[w], (unsigned long long)t->requests[w],
+		        (unsigned long long)tracepercentile(w, 0.5),
+		        (unsigned long long)tracepercentile(w, 0.99));
+		for (i = 0, b = 0; b < TRACEBUCKETS; b++)
+			if (t->hist[w][b])
+				fprintf(f, "%s[%llu,%u]", i++ ? "," : "",
+				        (unsigned long long)tracebucketmin(b), t->hist[w][b]);
+		fputs("]}", f);
+		first = 0;
+	}
+	fputs("\n}}\n", f);
+	fclose(f);
+	showmsg("trace written to " TRACEFILE, 3000);
+}
+#endif /* TRACE */
+
+/* one control message, from the self-pipe (a single byte) or a datagram on
+ * the control socket: an opcode followed by its argument as text, as in
+ * "r", "s3 42%", "v4", "g2" or "l1". Tag masks and layout indices come from
+ * the sender, so they are checked here. */
+static void
+ctlmsg(const char *m, size_t n)
+{
+	char num[16];
+	Arg a;
+
+	snprintf(num, sizeof num, "%.*s", (int)MIN(n - 1, sizeof num - 1), m + 1);
+	switch (m[0]) {
+	case CtlReload:
+		reloads(NULL);
+		break;
+	case CtlQuit:
+		quit(NULL);
+		break;
+#ifdef TRACE
+	case CtlTrace:
+		tracedump();
+		break;
+#endif
+	case CtlStatus:
+		if (n >= 2 && m[1] >= '0' && m[1] < '0' + STATUSSEGS)
+			setstatus(m[1] - '0', m + 2, n - 2);
+		break;
+	case CtlView:
+		a.ui = strtoul(num, NULL, 10);
+		view(&a);
+		break;
+	case CtlTag:
+		if ((a.ui = strtoul(num, NULL, 10) & TAGMASK))
+			tag(&a);
+		break;
+	case CtlLayout:
+		if ((a.ui = strtoul(num, NULL, 10)) < LENGTH(layouts)) {
+			a.v = &layouts[a.ui];
+			setlayout(&a);
+		}
+		break;
+	}
+}
+
+/* bind the control socket at $XDG_RUNTIME_DIR/dwm-$DISPLAY.sock (or under
+ * /tmp), where dwmc(1) looks for it. Without one dwm runs on, minus ctlmsg()
+ * from outside. */
+static void
+opensock(void)
+{
+	struct sockaddr_un sa = { .sun_family = AF_UNIX };
+	const char *dir = getenv("XDG_RUNTIME_DIR");
+	mode_t mask;
+
+	(*plug).sockfd = -1;
+	if (snprintf(sa.sun_path, sizeof sa.sun_path, "%s/dwm-%s.sock", dir ? dir : "/tmp",
+	    DisplayString((*plug).dpy)) >= (int)sizeof sa.sun_path) {
+		fputs("dwm: control socket path too long\n", stderr);
+		return;
+	}
+	memcpy((*plug).sockpath, sa.sun_path, sizeof sa.sun_path);
+	unlink(sa.sun_path); /* left behind by a dwm that did not exit cleanly */
+	if (((*plug).sockfd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) == -1) {
+		perror("dwm: control socket");
+		return;
+	}
+	mask = umask(077); /* only our user may send */
+	if (bind((*plug).sockfd, (struct sockaddr *)&sa, sizeof sa) == -1) {
+		perror("dwm: control socket");
+		close((*plug).sockfd);
+		(*plug).sockfd = -1;
+	}
+	umask(mask);
+}
+
+/* Monitor.shelf lists its minimized clients in the order they were
+ * minimized, each knowing its slot: adding one appends it, removing one
+ * moves only those after it. */
+static void
+shelfadd(Client *c)
+{
+	Monitor *m = c->mon;
+
+	if (m->nshelf == m->shelfcap) {
+		m->shelfcap = m->shelfcap ? m->shelfcap * 2 : 8;
+		if (!(m->shelf = realloc(m->shelf, m->shelfcap * sizeof(Client *))))
+			die("realloc:");
+	}
+	COLD(c)->shelfslot = m->nshelf;
+	m->shelf[m->nshelf++] = c;
+	m->shelfgen++;
+}
+
+static void
+shelfdel(Client *c)
+{
+	Monitor *m = c->mon;
+	unsigned int i;
+
+	for (i = COLD(c)->shelfslot; i + 1 < m->nshelf; i++) {
+		m->shelf[i] = m->shelf[i + 1];
+		COLD(m->shelf[i])->shelfslot = i;
+	}
+	m->nshelf--;
+	m->shelfgen++;
+}
+
+/* give m the screen area x, y, w, h, marking it geomdirty if that moved it */
+static int
+setgeom(Monitor *m, int x, int y, int w, int h)
+{
+	if (x == m->mx && y == m->my && w == m->mw && h == m->mh)
+		return 0;
+	m->mx = m->wx = x;
+	m->my = m->wy = y;
+	m->mw = m->ww = w;
+	m->mh = m->wh = h;
+	updatebarpos(m);
+	m->geomdirty = 1;
+	return 1;
+}
+
+#ifdef XRANDR
+/* Diff the RandR 1.5 monitors against ours by name, so an output keeps its
+ * Monitor across hotplugs: only new, moved or resized monitors and those
+ * taking the clients of removed ones are marked geomdirty. */
+static int
+rrgeom(void)
+{
+	XRRMonitorInfo *info;
+	Monitor *m, *next, *to, **mp;
+	Client *c;
+	char *taken;
+	int i, j, n, dirty = 0;
+
+	if (!(info = XRRGetMonitors((*plug).dpy, (*plug).root, True, &n)))
+		n = 0;
+	taken = ecalloc(n + 1, 1);
+	for (i = 0; i < n; i++) /* only unique geometries are separate monitors */
+		for (j = 0; j < i && !taken[i]; j++)
+			taken[i] = info[j].x == info[i].x && info[j].y == info[i].y
+				&& info[j].width == info[i].width && info[j].height == info[i].height;
+	for (mp = &(*plug).mons; (m = *mp); mp = &m->next) {
+		for (i = 0; i < n && (taken[i] || info[i].name != m->output); i++);
+		if (i == n) {
+			m->geomdirty = -1; /* removed below, once the new ones exist */
+			dirty = 1;
+		} else {
+			taken[i] = 1;
+			dirty |= setgeom(m, info[i].x, info[i].y, info[i].width, info[i].height);
+		}
+	}
+	for (i = 0; i < n; i++)
+		if (!taken[i]) {
+			*mp = m = createmon();
+			m->output = info[i].name;
+			setgeom(m, info[i].x, info[i].y, info[i].width, info[i].height);
+			mp = &m->next;
+			dirty = 1;
+		}
+	for (m = (*plug).mons; m && m->geomdirty == -1; m = m->next);
+	if (!m) { /* no output is active, keep one monitor over the screen */
+		*mp = m = createmon();
+		setgeom(m, 0, 0, (*plug).sw, (*plug).sh);
+	}
+	for (m = (*plug).mons; m; m = next) {
+		next = m->next;
+		if (m->geomdirty != -1)
+			continue;
+		for (to = (*plug).mons; to->geomdirty == -1; to = to->next);
+		while ((c = m->clients)) {
+			m->clients = c->next;
+			detachstack(c);
+			if (c->isminimized)
+				shelfdel(c);
+			c->mon = to;
+			attach(c);
+			attachstack(c);
+			if (c->isminimized)
+				shelfadd(c);
+			to->geomdirty = 1;
+		}
+		if (m == (*plug).selmon)
+			(*plug).selmon = to;
+		cleanupmon(m);
+	}
+	for (i = 0, m = (*plug).mons; m; m = m->next, i++)
+		m->num = i;
+	free(taken);
+	if (info)
+		XRRFreeMonitors(info);
+	return dirty;
+}
+
+/* turn a RandR event into a ConfigureNotify of the root with the screen size
+ * of now: configurenotify() diffs the monitors whatever changed, and
+ * coalesce() folds the handful one hotplug sends into one */
+static void
+rrconfigure(XEvent *e)
+{
+	if (e->type == (*plug).rrbase + RRScreenChangeNotify)
+		XRRUpdateConfiguration(e);
+	e->type = ConfigureNotify;
+	e->xconfigure.window = (*plug).root;
+	e->xconfigure.width = DisplayWidth((*plug).dpy, (*plug).screen);
+	e->xconfigure.height = DisplayHeight((*plug).dpy, (*plug).screen);
+}
+#endif /* XRANDR */
+
+/* Plug.wintab indexes every managed client by its window, open-addressed
+ * with linear probing and kept at most half full. */
+static unsigned int
+winhash(Window w)
+{
+	unsigned long h = w;
+
+	h = (h ^ (h >> 16)) * 0x45D9F3B;
+	return h ^ (h >> 16);
+}
+
+static void
+wintabadd(Client *c)
+{
+	unsigned int i, mask, oldcap = (*plug).wintabcap;
+	Client **old = (*plug).wintab;
+
+	if (((*plug).nwintab + 1) * 2 > oldcap) {
+		(*plug).wintabcap = oldcap ? oldcap * 2 : 64;
+		(*plug).wintab = ecalloc((*plug).wintabcap, sizeof(Client *));
+		(*plug).nwintab = 0;
+		for (i = 0; i < oldcap; i++)
+			if (old[i])
+				wintabadd(old[i]);
+		free(old);
+	}
+	mask = (*plug).wintabcap - 1;
+	for (i = winhash(c->win) & mask; (*plug).wintab[i]; i = (i + 1) & mask);
+	(*plug).wintab[i] = c;
+	(*plug).nwintab++;
+}
+
+static void
+wintabdel(Client *c)
+{
+	unsigned int i, j, k, mask = (*plug).wintabcap - 1;
+	Client **t = (*plug).wintab;
+
+	if (!(*plug).wintabcap)
+		return;
+	for (i = winhash(c->win) & mask; t[i] && t[i] != c; i = (i + 1) & mask);
+	if (!t[i])
+		return;
+	/* shift back later entries of the probe run that hash at or before i */
+	for (j = i; t[j = (j + 1) & mask];) {
+		k = winhash(t[j]->win) & mask;
+		if (i <= j ? (k <= i || k > j) : (k <= i && k > j)) {
+			t[i] = t[j];
+			i = j;
+		}
+	}
+	t[i] = NULL;
+	(*plug).nwintab--;
+}
+
+/* Clients come in 64-byte aligned slabs of POOLSLAB, each paired for good
+ * with a ClientCold in Plug.cold, and freed ones wait in Plug.freeclients */
+static Client *
+clientalloc(void)
+{
+	Client *c, *s;
+	unsigned int i, cold;
+
+	if (!(*plug).freeclients) {
+		if (posix_memalign((void **)&s, 64, POOLSLAB * sizeof(Client)))
+			die("posix_memalign:");
+		if ((*plug).ncold + POOLSLAB > (*plug).coldcap) {
+			(*plug).coldcap = MAX((*plug).coldcap * 2, (*plug).ncold + POOLSLAB);
+			if (!((*plug).cold = realloc((*plug).cold, (*plug).coldcap * sizeof(ClientCold))))
+				die("realloc:");
+		}
+		for (i = 0; i < POOLSLAB; i++) {
+			s[i].cold = (*plug).ncold++;
+			s[i].next = (*plug).freeclients;
+			(*plug).freeclients = &s[i];
+		}
+	}
+	c = (*plug).freeclients;
+	(*plug).freeclients = c->next;
+	cold = c->cold;
+	memset(c, 0, sizeof *c);
+	c->cold = cold;
+	memset(COLD(c), 0, sizeof(ClientCold));
+	return c;
+}
+
+static void
+clientfree(Client *c)
+{
+	c->next = (*plug).freeclients;
+	(*plug).freeclients = c;
+}
+
+/* Plug.keytab maps (keycode, modifiers) to the keys[] bound to them;
+ * grabkeys() fills it, open-addressed and at most half full. */
+static unsigned int
+keyhash(unsigned int code, unsigned int mask)
+{
+	return winhash(code << 8 | mask);
+}
+
+static void
+keytabadd(unsigned int code, unsigned int mask, unsigned int key)
+{
+	unsigned int i, m = (*plug).keytabcap - 1;
+
+	for (i = keyhash(code, mask) & m; (*plug).keytab[i].key; i = (i + 1) & m);
+	(*plug).keytab[i].code = code;
+	(*plug).keytab[i].mask = mask;
+	(*plug).keytab[i].key = key + 1;
+}
+
+/* Our passive grabs on the root, as the sorted set g: grabset() sends only
+ * the grabs and ungrabs that turn it into want, which it then takes over. */
+static int
+grabcmp(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void
+grabset(GrabSet *g, uint32_t *want, unsigned int n, int buttons)
+{
+	unsigned int i, j, k;
+	uint32_t v;
+
+	qsort(want, n, sizeof *want, grabcmp);
+	for (i = k = 0; i < n; i++) /* a numlockmask of 0 repeats modifiers */
+		if (!k || want[i] != want[k - 1])
+			want[k++] = want[i];
+	for (i = j = 0; i < g->n || j < k; ) {
+		if (j == k || (i < g->n && g->v[i] < want[j])) {
+			v = g->v[i++];
+			if (buttons)
+				XUngrabButton((*plug).dpy, v >> 16, v & 0xffff, (*plug).root);
+			else
+				XUngrabKey((*plug).dpy, v >> 16, v & 0xffff, (*plug).root);
+		} else if (i == g->n || want[j] < g->v[i]) {
+			v = want[j++];
+			if (buttons)
+				XGrabButton((*plug).dpy, v >> 16, v & 0xffff, (*plug).root, False,
+				            BUTTONMASK, GrabModeSync, GrabModeAsync, None, None);
+			else
+				XGrabKey((*plug).dpy, v >> 16, v & 0xffff, (*plug).root, True,
+				         GrabModeAsync, GrabModeAsync);
+		} else
+			i++, j++;
+	}
+	free(g->v);
+	g->v = want;
+	g->n = k;
+}
+
+/* Plug.clientlist keeps the managed windows in mapping order, written to
+ * _NET_CLIENT_LIST with one request by updateclientlist() */
+static void
+clientlistadd(Window w)
+{
+	if ((*plug).nclientlist == (*plug).clientlistcap) {
+		(*plug).clientlistcap = (*plug).clientlistcap ? (*plug).clientlistcap * 2 : 64;
+		if (!((*plug).clientlist = realloc((*plug).clientlist,
+		    (*plug).clientlistcap * sizeof(Window))))
+			die("realloc:");
+	}
+	(*plug).clientlist[(*plug).nclientlist++] = w;
+	(*plug).clientlistdirty = 1;
+}
+
+static void
+clientlistdel(Window w)
+{
+	unsigned int i;
+
+	for (i = 0; i < (*plug).nclientlist && (*plug).clientlist[i] != w; i++);
+	if (i == (*plug).nclientlist)
+		return;
+	memmove(&(*plug).clientlist[i], &(*plug).clientlist[i + 1],
+	        ((*plug).nclientlist - i - 1) * sizeof(Window));
+	(*plug).nclientlist--;
+	(*plug).clientlistdirty = 1;
+}
+
+/* Stack the bar and the visible tiled clients of m top down, as restack()
+ * always did, but against m->stacked, the order it sent last: windows
+ * before the first and after the last difference already are in place,
+ * those between go below the last one before in one XRestackWindows().
+ * Returns whether anything was sent. */
+static int
+restackdiff(Monitor *m)
+{
+	Window *w, *tw;
+	Client *c;
+	unsigned int i, k, n = 1, p, q, tcap;
+
+	for (c = m->stack; c; c = c->snext)
+		n += !c->isfloating && ISVISIBLE(c);
+	if (n > (*plug).stackcap) {
+		(*plug).stackcap = n * 2;
+		free((*plug).stacknew);
+		(*plug).stacknew = ecalloc((*plug).stackcap, sizeof(Window));
+	}
+	w = (*plug).stacknew;
+	w[0] = m->barwin;
+	for (i = 1, c = m->stack; c; c = c->snext)
+		if (!c->isfloating && ISVISIBLE(c))
+			w[i++] = c->win;
+	for (p = 0; p < n && p < m->nstacked && w[p] == m->stacked[p]; p++);
+	for (q = 0; q < n - p && q < m->nstacked - p
+	     && w[n - 1 - q] == m->stacked[m->nstacked - 1 - q]; q++);
+	k = p ? p - 1 : 0; /* w[p] up to w[n - q - 1] moved, w[k] stays */
+	if (p + q < n && n - q - k > 1)
+		XRestackWindows((*plug).dpy, w + k, n - q - k);
+	/* keep w as m->stacked, the old array is the next scratch */
+	tw = m->stacked;
+	tcap = m->stackedcap;
+	m->stacked = w;
+	m->stackedcap = (*plug).stackcap;
+	m->nstacked = n;
+	(*plug).stacknew = tw;
+	(*plug).stackcap = tcap;
+	return p + q < n && n - q - k > 1;
+}
+
+/* make room for n entries in Plug.place */
+static void
+placereserve(unsigned int n)
+{
+	if (n <= (*plug).placecap)
+		return;
+	(*plug).placecap = MAX(n, (*plug).placecap ? (*plug).placecap * 2 : 64);
+	if (!((*plug).place = realloc((*plug).place, (*plug).placecap * sizeof(Place))))
+		die("realloc:");
+}
+
+static void
+arrangekey(Monitor *m, ArrangeKey *k)
+{
+	memset(k, 0, sizeof *k);
+	k->lt = m->lt[m->sellt];
+	k->tagset = m->tagset[m->seltags];
+	k->clientgen = (*plug).clientgen;
+	k->mfact = m->mfact;
+	k->nmaster = m->nmaster;
+	k->wx = m->wx;
+	k->wy = m->wy;
+	k->ww = m->ww;
+	k->wh = m->wh;
+}
+
+/* Timers live in a binary min-heap inside Plug, ordered by deadline;
+ * timerslot[id] holds the heap index + 1 of timer id (0 if unused). The
+ * timerfd polled by run() is always armed for the heap root. */
+static void
+timerswap(int i, int j)
+{
+	Timer t = (*plug).timers[i];
+
+	(*plug).timers[i] = (*plug).timers[j];
+	(*plug).timers[j] = t;
+	(*plug).timerslot[(*plug).timers[i].id] = i + 1;
+	(*plug).timerslot[(*plug).timers[j].id] = j + 1;
+}
+
+static void
+timersift(int i)
+{
+	int l, r, min;
+	Timer *t = (*plug).timers;
+
+	for (; i > 0 && t[i].deadline < t[(i - 1) / 2].deadline; i = (i - 1) / 2)
+		timerswap(i, (i - 1) / 2);
+	for (;; i = min) {
+		l = 2 * i + 1;
+		r = l + 1;
+		min = i;
+		if (l < (*plug).ntimers && t[l].deadline < t[min].deadline)
+			min = l;
+		if (r < (*plug).ntimers && t[r].deadline < t[min].deadline)
+			min = r;
+		if (min == i)
+			break;
+		timerswap(i, min);
+	}
+}
+
+static void
+timerarm(void)
+{
+	struct itimerspec its = { 0 }; /* all zero disarms */
+	uint64_t d;
+
+	if ((*plug).ntimers) {
+		d = MAX((*plug).timers[0].deadline, 1);
+		its.it_value.tv_sec = d / 1000;
+		its.it_value.tv_nsec = (d % 1000) * 1000000;
+	}
+	timerfd_settime((*plug).tfd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+/* the window an event is about; substructure events carry the parent
+ * in xany.window */
+static Window
+evwin(XEvent *e)
+{
+	switch (e->type) {
+	case ConfigureRequest: return e->xconfigurerequest.window;
+	case ConfigureNotify:  return e->xconfigure.window;
+	case DestroyNotify:    return e->xdestroywindow.window;
+	case MapRequest:       return e->xmaprequest.window;
+	case UnmapNotify:      return e->xunmap.window;
+	default:               return e->xany.window;
+	}
+}
+
+/* Drop the events of a batch that a later one makes redundant, by
+ * zeroing their type: a PropertyNotify followed by another of the same
+ * window, atom and state, a ConfigureNotify of the root followed by
+ * another, and a ConfigureRequest whose window's next event is another
+ * ConfigureRequest, which then takes over the fields it does not set
+ * itself. */
+static void
+coalesce(XEvent *ev, int n)
+{
+	XConfigureRequestEvent *a, *b;
+	XPropertyEvent *p, *q;
+	Window w;
+	int i, j;
+
+	for (i = 0; i < n; i++) {
+		if (ev[i].type == PropertyNotify) {
+			p = &ev[i].xproperty;
+			for (j = i + 1; j < n; j++) {
+				q = &ev[j].xproperty;
+				if (ev[j].type == PropertyNotify && q->window == p->window
+				    && q->atom == p->atom && q->state == p->state) {
+					ev[i].type = 0;
+					break;
+				}
+			}
+		} else if (ev[i].type == ConfigureNotify && ev[i].xconfigure.window == (*plug).root) {
+			for (j = i + 1; j < n && (ev[j].type != ConfigureNotify
+			     || ev[j].xconfigure.window != (*plug).root); j++);
+			if (j < n)
+				ev[i].type = 0;
+		} else if (ev[i].type == ConfigureRequest) {
+			a = &ev[i].xconfigurerequest;
+			w = a->window;
+			for (j = i + 1; j < n && (!ev[j].type || evwin(&ev[j]) != w); j++);
+			if (j == n || ev[j].type != ConfigureRequest)
+				continue;
+			b = &ev[j].xconfigurerequest;
+			if (!(b->value_mask & CWX))           b->x = a->x;
+			if (!(b->value_mask & CWY))           b->y = a->y;
+			if (!(b->value_mask & CWWidth))       b->width = a->width;
+			if (!(b->value_mask & CWHeight))      b->height = a->height;
+			if (!(b->value_mask & CWBorderWidth)) b->border_width = a->border_width;
+			if (!(b->value_mask & CWSibling))     b->above = a->above;
+			if (!(b->value_mask & CWStackMode))   b->detail = a->detail;
+			b->value_mask |= a->value_mask;
+			ev[i].type = 0;
+		}
+	}
+}
+
+/* or into bits the rules with a field pattern found in text */
+static void
+rulescan(const char *text, int field, uint64_t *bits)
+{
+	RuleIndex *x = &(*plug).rules;
+	unsigned int i, st = 0;
+	const uint64_t *o;
+
+	for (;; text++) {
+		o = &x->out[(st * RuleLast + field) * x->nw];
+		for (i = 0; i < x->nw; i++)
+			bits[i] |= o[i];
+		if (!*text)
+			break;
+		st = x->delta[st * x->ncls + x->cls[(unsigned char)*text]];
+	}
+}
+
+static unsigned int
+strhash(const char *s)
+{
+	unsigned int h = 2166136261u;
+
+	for (; *s; s++)
+		h = (h ^ (unsigned char)*s) * 16777619u;
+	return h;
+}
+
+/* rule matching, for the WM_CLASS of c */
+static void
+matchrules(Client *c, const char *class, const char *instance)
+{
+	unsigned int i, j, slot;
+	uint64_t hit[RULEWORDS], f[RuleLast][RULEWORDS];
+	RuleIndex *x = &(*plug).rules;
+	const Rule *r;
+	Monitor *m;
+
+	c->isfloating = 0;
+	c->tags = 0;
+	class    = class    ? class    : (*plug).broken;
+	instance = instance ? instance : (*plug).broken;
+
+	/* rules whose class and instance match, as strstr() would have it */
+	slot = (strhash(class) ^ strhash(instance) * 31) % RULEMEMO;
+	if (x->memo[slot].used && !strcmp(x->memo[slot].class, class)
+	    && !strcmp(x->memo[slot].instance, instance))
+		memcpy(hit, &x->memobits[slot * x->nw], sizeof hit);
+	else {
+		memset(f, 0, sizeof f);
+		rulescan(class, RuleClass, f[RuleClass]);
+		rulescan(instance, RuleInstance, f[RuleInstance]);
+		for (i = 0; i < RULEWORDS; i++)
+			hit[i] = (~x->has[RuleClass * x->nw + i] | f[RuleClass][i])
+			       & (~x->has[RuleInstance * x->nw + i] | f[RuleInstance][i]);
+		if (strlen(class) < sizeof x->memo[slot].class
+		    && strlen(instance) < sizeof x->memo[slot].instance) {
+			strcpy(x->memo[slot].class, class);
+			strcpy(x->memo[slot].instance, instance);
+			x->memo[slot].used = 1;
+			memcpy(&x->memobits[slot * x->nw], hit, sizeof hit);
+		}
+	}
+	/* titles differ per window */
+	memset(f[RuleTitle], 0, sizeof f[RuleTitle]);
+	rulescan(COLD(c)->name, RuleTitle, f[RuleTitle]);
+	for (i = 0; i < RULEWORDS; i++)
+		hit[i] &= ~x->has[RuleTitle * x->nw + i] | f[RuleTitle][i];
+
+	for (i = 0; i < RULEWORDS; i++)
+		for (; hit[i]; hit[i] &= hit[i] - 1) {
+			j = i * 64 + __builtin_ctzll(hit[i]);
+			if (j >= LENGTH(rules))
+				break;
+			r = &rules[j];
+			c->isfloating = r->isfloating;
+			c->tags |= r->tags;
+			for (m = (*plug).mons; m && m->num != r->monitor; m = m->next);
+			if (m)
+				c->mon = m;
+		}
+	c->tags = c->tags & TAGMASK ? c->tags & TAGMASK : c->mon->tagset[c->mon->seltags];
+}
+
+/* the part of updatesizehints() that follows fetching them */
+static void
+setsizehints(Client *c, const XSizeHints *size)
+{
+	ClientCold *cc = COLD(c);
+
+	if (size->flags & PBaseSize) {
+		cc->basew = size->base_width;
+		cc->baseh = size->base_height;
+	} else if (size->flags & PMinSize) {
+		cc->basew = size->min_width;
+		cc->baseh = size->min_height;
+	} else
+		cc->basew = cc->baseh = 0;
+	if (size->flags & PResizeInc) {
+		cc->incw = size->width_inc;
+		cc->inch = size->height_inc;
+	} else
+		cc->incw = cc->inch = 0;
+	if (size->flags & PMaxSize) {
+		cc->maxw = size->max_width;
+		cc->maxh = size->max_height;
+	} else
+		cc->maxw = cc->maxh = 0;
+	if (size->flags & PMinSize) {
+		cc->minw = size->min_width;
+		cc->minh = size->min_height;
+	} else if (size->flags & PBaseSize) {
+		cc->minw = size->base_width;
+		cc->minh = size->base_height;
+	} else
+		cc->minw = cc->minh = 0;
+	if (size->flags & PAspect) {
+		cc->mina = (float)size->min_aspect.y / size->min_aspect.x;
+		cc->maxa = (float)size->max_aspect.x / size->max_aspect.y;
+	} else
+		cc->maxa = cc->mina = 0.0;
+	c->isfixed = (cc->maxw && cc->maxh && cc->maxw == cc->minw && cc->maxh == cc->minh);
+	c->hintsvalid = 1;
+	(*plug).clientgen++;
+}
+
+/* the part of updatewmhints() that follows fetching them */
+static void
+setwmhints(Client *c, XWMHints *wmh)
+{
+	if (c == (*plug).selmon->sel && wmh->flags & XUrgencyHint) {
+		wmh->flags &= ~XUrgencyHint;
+		XSetWMHints((*plug).dpy, c->win, wmh);
+	} else
+		c->isurgent = (wmh->flags & XUrgencyHint) ? 1 : 0;
+	if (wmh->flags & InputHint)
+		c->neverfocus = !wmh->input;
+	else
+		c->neverfocus = 0;
+}
+
+/* the part of updatewindowtype() that follows fetching the atoms */
+static void
+setwindowtype(Client *c, Atom state, Atom wtype)
+{
+	if (state == (*plug).netatom[NetWMFullscreen])
+		setfullscreen(c, 1);
+	if (wtype == (*plug).netatom[NetWMWindowTypeDialog]) {
+		c->isfloating = 1;
+		(*plug).clientgen++;
+	}
+}
 
-Plug *plug;
+/* convert a text property to a string of at most size - 1 bytes */
+static int
+textprop(XTextProperty *name, char *text, unsigned int size)
+{
+	char **list = NULL;
+	int n;
 
-/* configuration, allows nested code to access above variables */
-#include "config.h"
+	if (!name->nitems)
+		return 0;
+	if (name->encoding == XA_STRING) {
+		strncpy(text, (char *)name->value, MIN(size - 1, name->nitems));
+		text[MIN(size - 1, name->nitems)] = '\0';
+	} else if (XmbTextPropertyToTextList((*plug).dpy, name, &list, &n) >= Success && n > 0 && *list) {
+		strncpy(text, *list, size - 1);
+		XFreeStringList(list);
+	}
+	text[size - 1] = '\0';
+	return 1;
+}
 
-/* compile-time check if all tags fit into an unsigned int bit array. */
-struct NumTags { char limitexceeded[LENGTH(tags) > 31 ? -1 : 1]; };
+/* Request every property manage() reads at once through XCB and wait
+ * for the replies together, one round trip instead of one each. */
+static void
+fetchprops(Window w, xcb_get_property_reply_t *r[PropLast])
+{
+	static const uint32_t len[PropLast] = { 64, 64, 1, 256, 1, 1, 18, 9 }; /* in longs */
+	xcb_connection_t *xc = XGetXCBConnection((*plug).dpy);
+	xcb_get_property_cookie_t ck[PropLast];
+	const Atom atom[PropLast] = {
+		(*plug).netatom[NetWMName], XA_WM_NAME, XA_WM_TRANSIENT_FOR, XA_WM_CLASS,
+		(*plug).netatom[NetWMState], (*plug).netatom[NetWMWindowType],
+		XA_WM_NORMAL_HINTS, XA_WM_HINTS
+	}, type[PropLast] = {
+		AnyPropertyType, AnyPropertyType, XA_WINDOW, XA_STRING,
+		XA_ATOM, XA_ATOM, XA_WM_SIZE_HINTS, XA_WM_HINTS
+	};
+	int i;
 
-/* function implementations */
+	for (i = 0; i < PropLast; i++)
+		ck[i] = xcb_get_property(xc, 0, w, atom[i], type[i], 0, len[i]);
+	for (i = 0; i < PropLast; i++)
+		if ((r[i] = xcb_get_property_reply(xc, ck[i], NULL)) && !r[i]->value_len) {
+			free(r[i]); /* unset, or of another type */
+			r[i] = NULL;
+		}
+	/* a name cut short may end mid-character and fail to convert: fetch
+	 * the longer ones whole, in a second round trip */
+	for (i = PropNetWMName; i <= PropWMName; i++)
+		if (r[i] && r[i]->bytes_after)
+			ck[i] = xcb_get_property(xc, 0, w, atom[i], type[i], 0,
+			        len[i] + (r[i]->bytes_after + 3) / 4);
+	for (i = PropNetWMName; i <= PropWMName; i++)
+		if (r[i] && r[i]->bytes_after) {
+			free(r[i]);
+			r[i] = xcb_get_property_reply(xc, ck[i], NULL);
+		}
+}
 
-#define TIMEBARWIDTH 64
-char *get_time_bar() {
-	time_t t = time(NULL);
-	struct tm *tm = localtime(&t);
-	if (!tm) return NULL;
-    
-	char *text = malloc(TIMEBARWIDTH);
-	if (!text) return NULL;
-
-	if (!strftime(text, TIMEBARWIDTH, "%d/%m/%Y %H-%M-%S", tm)) {
-		free(text);
-		return NULL;
+/* the first 32 bit item of a property reply, or None */
+static unsigned long
+propcard(xcb_get_property_reply_t *r)
+{
+	return r && r->format == 32 ? *(uint32_t *)xcb_get_property_value(r) : None;
+}
+
+/* XGetWMNormalHints() for a property reply */
+static int
+propsizehints(xcb_get_property_reply_t *r, XSizeHints *size)
+{
+	int32_t *v;
+
+	if (!r || r->format != 32 || r->value_len < 15)
+		return 0;
+	v = xcb_get_property_value(r);
+	size->flags = v[0];
+	size->x = v[1];
+	size->y = v[2];
+	size->width = v[3];
+	size->height = v[4];
+	size->min_width = v[5];
+	size->min_height = v[6];
+	size->max_width = v[7];
+	size->max_height = v[8];
+	size->width_inc = v[9];
+	size->height_inc = v[10];
+	size->min_aspect.x = v[11];
+	size->min_aspect.y = v[12];
+	size->max_aspect.x = v[13];
+	size->max_aspect.y = v[14];
+	if (r->value_len >= 18) {
+		size->base_width = v[15];
+		size->base_height = v[16];
+		size->win_gravity = v[17];
+	} else
+		size->flags &= ~(PBaseSize | PWinGravity); /* pre-ICCCM hints */
+	return 1;
+}
+
+/* XGetWMHints() for a property reply */
+static int
+propwmhints(xcb_get_property_reply_t *r, XWMHints *wmh)
+{
+	int32_t *v;
+
+	if (!r || r->format != 32 || r->value_len < 8)
+		return 0;
+	v = xcb_get_property_value(r);
+	wmh->flags = v[0];
+	wmh->input = v[1];
+	wmh->initial_state = v[2];
+	wmh->icon_pixmap = (uint32_t)v[3];
+	wmh->icon_window = (uint32_t)v[4];
+	wmh->icon_x = v[5];
+	wmh->icon_y = v[6];
+	wmh->icon_mask = (uint32_t)v[7];
+	wmh->window_group = r->value_len >= 9 ? (uint32_t)v[8] : 0;
+	if (r->value_len < 9)
+		wmh->flags &= ~WindowGroupHint;
+	return 1;
+}
+
+/* gettextprop() for a property reply */
+static int
+proptext(xcb_get_property_reply_t *r, char *text, unsigned int size)
+{
+	XTextProperty name;
+
+	text[0] = '\0';
+	if (!r)
+		return 0;
+	name.value = xcb_get_property_value(r);
+	name.encoding = r->type;
+	name.format = r->format;
+	name.nitems = r->value_len;
+	return textprop(&name, text, size);
+}
+
+/* draw the bars whose drawbar() was deferred while batching and write
+ * the client list its handlers changed */
+static void
+drawqueued(void)
+{
+	Monitor *m;
+
+	(*plug).batching = 0;
+	updateclientlist();
+	for (m = (*plug).mons; m; m = m->next)
+		if (m->bar.queued) {
+			m->bar.queued = 0;
+			drawbar(m);
+		}
+}
+
+static uint64_t
+syncvalue(XSyncValue v)
+{
+	return (uint64_t)(uint32_t)XSyncValueHigh32(v) << 32 | XSyncValueLow32(v);
+}
+
+/* Start a drag of c. With sync, resizes of a client that speaks
+ * _NET_WM_SYNC_REQUEST wait on its counter before the next one. */
+static void
+dragbegin(Drag *d, Client *c, int sync)
+{
+	Atom *protocols, type;
+	unsigned char *p = NULL;
+	unsigned long n, extra;
+	XSyncValue v;
+	int i, format, speaks = 0;
+
+	memset(d, 0, sizeof *d);
+	d->c = c;
+	d->counter = None;
+	if (!sync || !(*plug).havesync)
+		return;
+	if (XGetWMProtocols((*plug).dpy, c->win, &protocols, &i)) {
+		while (!speaks && i--)
+			speaks = protocols[i] == (*plug).netatom[NetWMSyncRequest];
+		XFree(protocols);
+	}
+	if (speaks && XGetWindowProperty((*plug).dpy, c->win, (*plug).netatom[NetWMSyncRequestCounter],
+	    0L, 2L, False, XA_CARDINAL, &type, &format, &n, &extra, &p) == Success && p) {
+		/* the first counter is the basic one, also for extended sync */
+		if (n && format == 32)
+			d->counter = *(long *)p;
+		XFree(p);
+	}
+	if (d->counter != None && XSyncQueryCounter((*plug).dpy, d->counter, &v))
+		d->serial = syncvalue(v);
+	else
+		d->counter = None;
+}
+
+/* ask the client of d to bump its counter once it painted the configure
+ * that follows */
+static void
+dragsync(Drag *d)
+{
+	XEvent ev;
+
+	if (d->counter == None)
+		return;
+	d->serial++;
+	ev.type = ClientMessage;
+	ev.xclient.window = d->c->win;
+	ev.xclient.message_type = (*plug).wmatom[WMProtocols];
+	ev.xclient.format = 32;
+	ev.xclient.data.l[0] = (*plug).netatom[NetWMSyncRequest];
+	ev.xclient.data.l[1] = d->time;
+	ev.xclient.data.l[2] = d->serial & 0xFFFFFFFF;
+	ev.xclient.data.l[3] = d->serial >> 32;
+	ev.xclient.data.l[4] = 0;
+	XSendEvent((*plug).dpy, d->c->win, False, NoEventMask, &ev);
+	d->sent = monotime();
+	d->waiting = 1;
+}
+
+static int
+cmpint(const void *a, const void *b)
+{
+	return (*(const int *)a > *(const int *)b) - (*(const int *)a < *(const int *)b);
+}
+
+/* Collect where the left and top edges of the dragged client may snap
+ * to on m: flush with the window area or with a visible client, or
+ * abutting the latter, sorted once for snapto(). */
+static void
+snapbuild(Drag *d, Monitor *m)
+{
+	Client *c = d->c, *o;
+	unsigned int n = 2;
+	int *x, *y;
+
+	for (o = m->clients; o; o = o->next)
+		if (o != c && ISVISIBLE(o))
+			n += 4;
+	x = d->snapx = ecalloc(n, sizeof(int));
+	y = d->snapy = ecalloc(n, sizeof(int));
+	*x++ = m->wx;
+	*y++ = m->wy;
+	*x++ = m->wx + m->ww - WIDTH(c);
+	*y++ = m->wy + m->wh - HEIGHT(c);
+	for (o = m->clients; o; o = o->next) {
+		if (o == c || !ISVISIBLE(o))
+			continue;
+		*x++ = o->x;
+		*y++ = o->y;
+		*x++ = o->x + WIDTH(o) - WIDTH(c);
+		*y++ = o->y + HEIGHT(o) - HEIGHT(c);
+		*x++ = o->x - WIDTH(c);
+		*y++ = o->y - HEIGHT(c);
+		*x++ = o->x + WIDTH(o);
+		*y++ = o->y + HEIGHT(o);
+	}
+	qsort(d->snapx, n, sizeof(int), cmpint);
+	qsort(d->snapy, n, sizeof(int), cmpint);
+	d->nsnap = n;
+}
+
+/* the edge of sorted e[n] nearest to v if closer than snap pixels,
+ * else v */
+static int
+snapto(const int *e, unsigned int n, int v)
+{
+	unsigned int lo = 0, hi = n, mid;
+	int best = v, dist = snap;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (e[mid] < v)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo < n && e[lo] - v < dist) {
+		best = e[lo];
+		dist = e[lo] - v;
+	}
+	if (lo > 0 && v - e[lo - 1] < dist)
+		best = e[lo - 1];
+	return best;
+}
+
+/* Wait for the next pointer position a drag should apply, in d->x, d->y.
+ * All pending motion is coalesced into the newest, which is held back
+ * until a frame passed since the last one and a synced client caught up;
+ * what is left on button release is handed out at once. Returns 0 when
+ * the drag is over. */
+static int
+dragnext(Drag *d)
+{
+	XEvent ev;
+	XSyncValue v;
+	struct pollfd pfd = { .fd = (*plug).xfd, .events = POLLIN };
+	uint64_t now, frame = 1000 / MAX(refreshrate, 1);
+
+	for (;;) {
+		while (!d->released && XCheckMaskEvent((*plug).dpy,
+		       MOUSEMASK|ExposureMask|SubstructureRedirectMask, &ev)) {
+			switch (ev.type) {
+			case ConfigureRequest:
+			case Expose:
+			case MapRequest:
+				(*plug).handler[ev.type](&ev);
+				break;
+			case MotionNotify:
+				d->x = ev.xmotion.x;
+				d->y = ev.xmotion.y;
+				d->time = ev.xmotion.time;
+				d->pending = 1;
+				break;
+			case ButtonRelease:
+				d->released = 1;
+				break;
+			}
+		}
+		if (d->released && !d->pending)
+			return 0;
+		now = monotime();
+		if (d->pending && d->waiting
+		    && (now - d->sent >= SYNCTIMEOUT || d->released
+		    || (XSyncQueryCounter((*plug).dpy, d->counter, &v) && syncvalue(v) >= d->serial)))
+			d->waiting = 0;
+		if (d->pending && !d->waiting && (d->released || now - d->last >= frame)) {
+			d->pending = 0;
+			d->last = now;
+			return 1;
+		}
+		XFlush((*plug).dpy);
+		if (poll(&pfd, 1, !d->pending ? -1 : d->waiting ? (int)frame
+		         : (int)(d->last + frame - now)) == -1 && errno != EINTR)
+			die("dwm: poll:");
 	}
+}
+
+int
+__addtimer(unsigned int ms, unsigned int interval, void (**func)(void))
+{
+	int id, i;
 
-	return text;
+	for (id = 0; id < MAXTIMERS && (*plug).timerslot[id]; id++);
+	if (id == MAXTIMERS)
+		return -1;
+	i = (*plug).ntimers++;
+	(*plug).timers[i] = (Timer){ monotime() + ms, interval, id, func };
+	(*plug).timerslot[id] = i + 1;
+	timersift(i);
+	timerarm();
+	return id;
 }
 
 void
 __applyrules(Client *c)
 {
-	const char *class, *instance;
-	unsigned int i;
-	const Rule *r;
-	Monitor *m;
 	XClassHint ch = { NULL, NULL };
 
-	/* rule matching */
-	c->isfloating = 0;
-	c->tags = 0;
 	XGetClassHint((*plug).dpy, c->win, &ch);
-	class    = ch.res_class ? ch.res_class : (*plug).broken;
-	instance = ch.res_name  ? ch.res_name  : (*plug).broken;
-
-	for (i = 0; i < LENGTH(rules); i++) {
-		r = &rules[i];
-		if ((!r->title || strstr(c->name, r->title))
-		    && (!r->class || strstr(class, r->class))
-		    && (!r->instance || strstr(instance, r->instance)))
-		{
-			c->isfloating = r->isfloating;
-			c->tags |= r->tags;
-			for (m = (*plug).mons; m && m->num != r->monitor; m = m->next);
-			if (m)
-				c->mon = m;
-		}
-	}
+	matchrules(c, ch.res_class, ch.res_name);
 	if (ch.res_class)
 		XFree(ch.res_class);
 	if (ch.res_name)
 		XFree(ch.res_name);
-	c->tags = c->tags & TAGMASK ? c->tags & TAGMASK : c->mon->tagset[c->mon->seltags];
 }
 
 int
 __applysizehints(Client *c, int *x, int *y, int *w, int *h, int interact)
 {
+	ClientCold *cc = COLD(c);
 	int baseismin;
 	Monitor *m = c->mon;
 
@@ -443,34 +1947,34 @@ __applysizehints(Client *c, int *x, int *y, int *w, int *h, int interact)
 		if (!c->hintsvalid)
 			updatesizehints(c);
 		/* see last two sentences in ICCCM 4.1.2.3 */
-		baseismin = c->basew == c->minw && c->baseh == c->minh;
+		baseismin = cc->basew == cc->minw && cc->baseh == cc->minh;
 		if (!baseismin) { /* temporarily remove base dimensions */
-			*w -= c->basew;
-			*h -= c->baseh;
+			*w -= cc->basew;
+			*h -= cc->baseh;
 		}
 		/* adjust for aspect limits */
-		if (c->mina > 0 && c->maxa > 0) {
-			if (c->maxa < (float)*w / *h)
-				*w = *h * c->maxa + 0.5;
-			else if (c->mina < (float)*h / *w)
-				*h = *w * c->mina + 0.5;
+		if (cc->mina > 0 && cc->maxa > 0) {
+			if (cc->maxa < (float)*w / *h)
+				*w = *h * cc->maxa + 0.5;
+			else if (cc->mina < (float)*h / *w)
+				*h = *w * cc->mina + 0.5;
 		}
 		if (baseismin) { /* increment calculation requires this */
-			*w -= c->basew;
-			*h -= c->baseh;
+			*w -= cc->basew;
+			*h -= cc->baseh;
 		}
 		/* adjust for increment value */
-		if (c->incw)
-			*w -= *w % c->incw;
-		if (c->inch)
-			*h -= *h % c->inch;
+		if (cc->incw)
+			*w -= *w % cc->incw;
+		if (cc->inch)
+			*h -= *h % cc->inch;
 		/* restore base dimensions */
-		*w = MAX(*w + c->basew, c->minw);
-		*h = MAX(*h + c->baseh, c->minh);
-		if (c->maxw)
-			*w = MIN(*w, c->maxw);
-		if (c->maxh)
-			*h = MIN(*h, c->maxh);
+		*w = MAX(*w + cc->basew, cc->minw);
+		*h = MAX(*h + cc->baseh, cc->minh);
+		if (cc->maxw)
+			*w = MIN(*w, cc->maxw);
+		if (cc->maxh)
+			*h = MIN(*h, cc->maxh);
 	}
 	return *x != c->x || *y != c->y || *w != c->w || *h != c->h;
 }
@@ -478,23 +1982,64 @@ __applysizehints(Client *c, int *x, int *y, int *w, int *h, int interact)
 void
 __arrange(Monitor *m)
 {
-	if (m)
+	ArrangeKey k;
+	int changed;
+
+	if (!m) {
+		for (m = (*plug).mons; m; m = m->next)
+			showhide(m->stack);
+		for (m = (*plug).mons; m; m = m->next)
+			arrangemon(m);
+		return;
+	}
+	/* with the same visible set and geometry, the windows are already
+	 * mapped and stacked as they would be again */
+	arrangekey(m, &k);
+	changed = memcmp(&k, &m->arranged, sizeof k) != 0;
+	if (changed)
 		showhide(m->stack);
-	else for (m = (*plug).mons; m; m = m->next)
-		     showhide(m->stack);
-	if (m) {
-		arrangemon(m);
+	arrangemon(m);
+	if (changed || m->stackgen != (*plug).stackgen || m->stacksel != m->sel) {
 		restack(m);
-	} else for (m = (*plug).mons; m; m = m->next)
-		       arrangemon(m);
+		m->stackgen = (*plug).stackgen;
+		m->stacksel = m->sel;
+	}
+	m->arranged = k;
 }
 
 void
 __arrangemon(Monitor *m)
 {
+	ArrangeKey k;
+	unsigned int i;
+	LayoutCache *e;
+
+	arrangekey(m, &k);
+	for (i = 0; i < ARRANGECACHE; i++) {
+		e = &m->lcache[i];
+		if (memcmp(&e->key, &k, sizeof k))
+			continue;
+		/* laid out like this before and nothing changed since */
+		strncpy(m->ltsymbol, e->ltsymbol, sizeof m->ltsymbol);
+		placereserve(e->n);
+		memcpy((*plug).place, e->place, e->n * sizeof(Place));
+		placeclients((*plug).nplace = e->n);
+		return;
+	}
 	strncpy(m->ltsymbol, m->lt[m->sellt]->symbol, sizeof m->ltsymbol);
+	(*plug).nplace = 0;
 	if (m->lt[m->sellt]->arrange)
 		(*m->lt[m->sellt]->arrange)(m);
+	e = &m->lcache[m->lnext++ % ARRANGECACHE];
+	if (e->cap < (*plug).nplace) {
+		e->cap = (*plug).nplace;
+		if (!(e->place = realloc(e->place, e->cap * sizeof(Place))))
+			die("realloc:");
+	}
+	memcpy(e->place, (*plug).place, (*plug).nplace * sizeof(Place));
+	e->n = (*plug).nplace;
+	e->key = k;
+	strncpy(e->ltsymbol, m->ltsymbol, sizeof e->ltsymbol);
 }
 
 void
@@ -502,6 +2047,7 @@ __attach(Client *c)
 {
 	c->next = c->mon->clients;
 	c->mon->clients = c;
+	(*plug).clientgen++;
 }
 
 void
@@ -509,6 +2055,7 @@ __attachstack(Client *c)
 {
 	c->snext = c->mon->stack;
 	c->mon->stack = c;
+	(*plug).stackgen++;
 }
 
 void
@@ -521,6 +2068,23 @@ __buttonpress(XEvent *e)
 	XButtonPressedEvent *ev = &e->xbutton;
 
 	click = ClkRootWin;
+	/* buttons grabbed on the root for the clients, see grabbuttons(),
+	 * report the window clicked as the subwindow and freeze the pointer:
+	 * a click on a window we do not manage is replayed to it, any other
+	 * press on the root thaws it, bare root included */
+	if (ev->window == (*plug).root) {
+		if (ev->subwindow != None) {
+			ev->window = ev->subwindow;
+			for (m = (*plug).mons; m && m->barwin != ev->window; m = m->next);
+			if (m)
+				ev->x = ev->x_root - m->wx;
+			else if (!wintoclient(ev->window)) {
+				XAllowEvents((*plug).dpy, ReplayPointer, CurrentTime);
+				return;
+			}
+		}
+		XAllowEvents((*plug).dpy, AsyncPointer, CurrentTime);
+	}
 	/* focus monitor if necessary */
 	if ((m = wintomon(ev->window)) && m != (*plug).selmon) {
 		unfocus((*plug).selmon->sel, 1);
@@ -530,14 +2094,17 @@ __buttonpress(XEvent *e)
 	if (ev->window == (*plug).selmon->barwin) {
 		i = x = 0;
 		do
-			x += TEXTW(tags[i]);
+			x += (*plug).tagw[i];
 		while (ev->x >= x && ++i < LENGTH(tags));
 		if (i < LENGTH(tags)) {
 			click = ClkTagBar;
 			arg.ui = 1 << i;
-		} else if (ev->x < x + TEXTW((*plug).selmon->ltsymbol))
+		} else if (ev->x < (x += (*plug).selmon->bar.ltw))
 			click = ClkLtSymbol;
-		else if (ev->x > (*plug).selmon->ww - (int)TEXTW((*plug).stext))
+		else if (ev->x < x + (*plug).selmon->bar.shelfw) {
+			click = ClkShelf;
+			arg.ui = (ev->x - x) / shelfslot;
+		} else if (ev->x > (*plug).selmon->ww - (*plug).selmon->bar.stw)
 			click = ClkStatusText;
 		else
 			click = ClkWinTitle;
@@ -550,7 +2117,8 @@ __buttonpress(XEvent *e)
 	for (i = 0; i < LENGTH(buttons); i++)
 		if (click == buttons[i].click && buttons[i].func && buttons[i].button == ev->button
 		    && CLEANMASK(buttons[i].mask) == CLEANMASK(ev->state))
-			(*buttons[i].func)(click == ClkTagBar && buttons[i].arg.i == 0 ? &arg : &buttons[i].arg);
+			(*buttons[i].func)((click == ClkTagBar || click == ClkShelf)
+			                   && buttons[i].arg.i == 0 ? &arg : &buttons[i].arg);
 }
 
 void
@@ -590,12 +2158,17 @@ __cleanup(void)
 	XSync((*plug).dpy, False);
 	XSetInputFocus((*plug).dpy, PointerRoot, RevertToPointerRoot, CurrentTime);
 	XDeleteProperty((*plug).dpy, (*plug).root, (*plug).netatom[NetActiveWindow]);
+	if ((*plug).sockfd != -1) {
+		close((*plug).sockfd);
+		unlink((*plug).sockpath);
+	}
 }
 
 void
 __cleanupmon(Monitor *mon)
 {
 	Monitor *m;
+	unsigned int i;
 
 	if (mon == (*plug).mons)
 		(*plug).mons = (*plug).mons->next;
@@ -605,9 +2178,23 @@ __cleanupmon(Monitor *mon)
 	}
 	XUnmapWindow((*plug).dpy, mon->barwin);
 	XDestroyWindow((*plug).dpy, mon->barwin);
+	drw_buf_free((*plug).drw, mon->barbuf);
+	for (i = 0; i < ARRANGECACHE; i++)
+		free(mon->lcache[i].place);
+	free(mon->shelf);
+	free(mon->stacked);
 	free(mon);
 }
 
+void
+__clearmsg(void)
+{
+	(*plug).msgtimer = -1;
+	(*plug).ctext[0] = '\0'; /* have updateclock() reshape the clock */
+	if (updateclock((*plug).clocksec))
+		drawbar((*plug).selmon);
+}
+
 void
 __clientmessage(XEvent *e)
 {
@@ -618,15 +2205,110 @@ __clientmessage(XEvent *e)
 		return;
 	if (cme->message_type == (*plug).netatom[NetWMState]) {
 		if (cme->data.l[1] == (*plug).netatom[NetWMFullscreen]
-		    || cme->data.l[2] == (*plug).netatom[NetWMFullscreen])
+		    || cme->data.l[2] == (*plug).netatom[NetWMFullscreen]) {
+			if (c->isminimized)
+				restore(c);
 			setfullscreen(c, (cme->data.l[0] == 1 /* _NET_WM_STATE_ADD    */
 					  || (cme->data.l[0] == 2 /* _NET_WM_STATE_TOGGLE */ && !c->isfullscreen)));
+		}
 	} else if (cme->message_type == (*plug).netatom[NetActiveWindow]) {
 		if (c != (*plug).selmon->sel && !c->isurgent)
 			seturgent(c, 1);
 	}
 }
 
+void
+__clocktick(void)
+{
+	struct timespec ts;
+	time_t t = time(NULL);
+
+	/* fire again just after the next wall-clock second starts */
+	clock_gettime(CLOCK_REALTIME, &ts);
+	settimer((*plug).clocktimer, 1000 - ts.tv_nsec / 1000000 + 1);
+	if (t == (*plug).clocksec)
+		return;
+	(*plug).clocksec = t;
+	if ((*plug).msgtimer == -1 && updateclock(t))
+		drawbar((*plug).selmon); /* only damages the status segment */
+}
+
+void
+__compilerules(void)
+{
+	RuleIndex *x = &(*plug).rules;
+	const char *p[RuleLast];
+	unsigned int i, j, k, n, st, t, cap, head, tail, *fail, *queue;
+	uint64_t *o, *fo;
+
+	free(x->delta);
+	free(x->out);
+	free(x->has);
+	free(x->memobits);
+	memset(x, 0, sizeof *x);
+	x->nw = RULEWORDS;
+	x->ncls = 1;
+	for (cap = 1, i = 0; i < LENGTH(rules); i++) {
+		p[RuleClass] = rules[i].class;
+		p[RuleInstance] = rules[i].instance;
+		p[RuleTitle] = rules[i].title;
+		for (k = 0; k < RuleLast; k++)
+			for (j = 0; p[k] && p[k][j]; j++, cap++)
+				if (!x->cls[(unsigned char)p[k][j]])
+					x->cls[(unsigned char)p[k][j]] = x->ncls++;
+	}
+	x->delta = ecalloc((size_t)cap * x->ncls, sizeof(unsigned int));
+	x->out = ecalloc((size_t)cap * RuleLast * x->nw, sizeof(uint64_t));
+	x->has = ecalloc(RuleLast * x->nw, sizeof(uint64_t));
+	x->memobits = ecalloc(RULEMEMO * x->nw, sizeof(uint64_t));
+
+	/* the trie of all patterns, state 0 being the root */
+	for (n = 1, i = 0; i < LENGTH(rules); i++) {
+		p[RuleClass] = rules[i].class;
+		p[RuleInstance] = rules[i].instance;
+		p[RuleTitle] = rules[i].title;
+		for (k = 0; k < RuleLast; k++) {
+			if (!p[k])
+				continue;
+			x->has[k * x->nw + i / 64] |= 1ULL << (i % 64);
+			for (st = 0, j = 0; p[k][j]; j++) {
+				t = st * x->ncls + x->cls[(unsigned char)p[k][j]];
+				if (!x->delta[t])
+					x->delta[t] = n++;
+				st = x->delta[t];
+			}
+			x->out[(st * RuleLast + k) * x->nw + i / 64] |= 1ULL << (i % 64);
+		}
+	}
+	x->nstates = n;
+
+	/* breadth first, turn it into a DFA: missing edges follow the failure
+	 * link and every state also reports what its failure state does */
+	fail = ecalloc(n, sizeof(unsigned int));
+	queue = ecalloc(n, sizeof(unsigned int));
+	head = tail = 0;
+	for (k = 0; k < x->ncls; k++)
+		if ((t = x->delta[k]))
+			queue[tail++] = t;
+	while (head < tail) {
+		st = queue[head++];
+		o = &x->out[st * RuleLast * x->nw];
+		fo = &x->out[fail[st] * RuleLast * x->nw];
+		for (j = 0; j < RuleLast * x->nw; j++)
+			o[j] |= fo[j];
+		for (k = 0; k < x->ncls; k++) {
+			t = x->delta[st * x->ncls + k];
+			if (t) {
+				fail[t] = x->delta[fail[st] * x->ncls + k];
+				queue[tail++] = t;
+			} else
+				x->delta[st * x->ncls + k] = x->delta[fail[st] * x->ncls + k];
+		}
+	}
+	free(fail);
+	free(queue);
+}
+
 void
 __configure(Client *c)
 {
@@ -652,24 +2334,24 @@ __configurenotify(XEvent *e)
 	Monitor *m;
 	Client *c;
 	XConfigureEvent *ev = &e->xconfigure;
-	int dirty;
 
-	/* TODO: updategeom handling sucks, needs to be simplified */
+	/* only monitors updategeom() marked geomdirty are touched, the bars
+	 * of new ones are created and the others stay as they are */
 	if (ev->window == (*plug).root) {
-		dirty = ((*plug).sw != ev->width || (*plug).sh != ev->height);
 		(*plug).sw = ev->width;
 		(*plug).sh = ev->height;
-		if (updategeom() || dirty) {
-			drw_resize((*plug).drw, (*plug).sw, (*plug).bh + 20);
+		if (updategeom()) {
 			updatebars();
 			for (m = (*plug).mons; m; m = m->next) {
+				if (!m->geomdirty)
+					continue;
 				for (c = m->clients; c; c = c->next)
 					if (c->isfullscreen)
 						resizeclient(c, m->mx, m->my, m->mw, m->mh);
 				XMoveResizeWindow((*plug).dpy, m->barwin, m->wx, m->by, m->ww, (*plug).bh + 20);
+				arrange(m);
 			}
 			focus(NULL);
-			arrange(NULL);
 		}
 	}
 }
@@ -684,24 +2366,25 @@ __configurerequest(XEvent *e)
 
 	if ((c = wintoclient(ev->window))) {
 		c->isfloating = 1;
+		(*plug).clientgen++;
 		if (ev->value_mask & CWBorderWidth)
 			c->bw = ev->border_width;
 		else if (c->isfloating || !(*plug).selmon->lt[(*plug).selmon->sellt]->arrange) {
 			m = c->mon;
 			if (ev->value_mask & CWX) {
-				c->oldx = c->x;
+				COLD(c)->oldx = c->x;
 				c->x = m->mx + ev->x;
 			}
 			if (ev->value_mask & CWY) {
-				c->oldy = c->y;
+				COLD(c)->oldy = c->y;
 				c->y = m->my + ev->y;
 			}
 			if (ev->value_mask & CWWidth) {
-				c->oldw = c->w;
+				COLD(c)->oldw = c->w;
 				c->w = ev->width;
 			}
 			if (ev->value_mask & CWHeight) {
-				c->oldh = c->h;
+				COLD(c)->oldh = c->h;
 				c->h = ev->height;
 			}
 			if ((c->x + c->w) > m->mx + m->mw && c->isfloating)
@@ -724,7 +2407,7 @@ __configurerequest(XEvent *e)
 		wc.stack_mode = ev->detail;
 		XConfigureWindow((*plug).dpy, ev->window, ev->value_mask, &wc);
 	}
-	XSync((*plug).dpy, False);
+	XSYNC((*plug).dpy);
 }
 
 Monitor *
@@ -744,6 +2427,23 @@ __createmon(void)
 	return m;
 }
 
+void
+__deltimer(int id)
+{
+	int i;
+
+	if (id < 0 || id >= MAXTIMERS || !(*plug).timerslot[id])
+		return;
+	i = (*plug).timerslot[id] - 1;
+	(*plug).timerslot[id] = 0;
+	if (i != --(*plug).ntimers) {
+		(*plug).timers[i] = (*plug).timers[(*plug).ntimers];
+		(*plug).timerslot[(*plug).timers[i].id] = i + 1;
+		timersift(i);
+	}
+	timerarm();
+}
+
 void
 __destroynotify(XEvent *e)
 {
@@ -761,6 +2461,7 @@ __detach(Client *c)
 
 	for (tc = &c->mon->clients; *tc && *tc != c; tc = &(*tc)->next);
 	*tc = c->next;
+	(*plug).clientgen++;
 }
 
 void
@@ -770,6 +2471,7 @@ __detachstack(Client *c)
 
 	for (tc = &c->mon->stack; *tc && *tc != c; tc = &(*tc)->snext);
 	*tc = c->snext;
+	(*plug).stackgen++;
 
 	if (c == c->mon->sel) {
 		for (t = c->mon->stack; t && !ISVISIBLE(t); t = t->snext);
@@ -792,61 +2494,126 @@ __dirtomon(int dir)
 	return m;
 }
 
+/* Each segment is redrawn and copied to barwin only when what it shows
+ * differs from m->bar, or when it was explicitly marked dirty. */
 void
 __drawbar(Monitor *m)
 {
-	int x, w, tw = 0;
+	int x, w, tw = 0, titlestate = 0, shelfw;
 	int boxs = (*plug).drw->fonts->h / 9;
 	int boxw = (*plug).drw->fonts->h / 6 + 2;
-	unsigned int i, occ = 0, urg = 0;
+	unsigned int i, occ = 0, urg = 0, seltags = 0, dirty;
 	Client *c;
 
-	if (!m->showbar)
+	if ((*plug).batching) {
+		m->bar.queued = 1;
+		return;
+	}
+	if (!m->showbar) {
+		m->bar.dirty = ~0; /* redraw it all once it is shown again */
 		return;
-
-	/* draw status first so it can be overdrawn by tags later */
-	if (m == (*plug).selmon) { /* status is only drawn on selected monitor */
-		drw_setscheme((*plug).drw, (*plug).scheme[SchemeNorm]);
-		char *ctime = get_time_bar();
-		tw = TEXTW(ctime) - (*plug).lrpad - 2;
-		drw_text((*plug).drw, m->ww - tw, 0, TEXTW(ctime), (*plug).bh, 0, ctime, 0);
-		free(ctime);
-		// tw = TEXTW(stext) - lrpad - 2; /* 2px right padding */
-		// drw_text(drw, m->ww - tw, 0, tw, bh, 0, stext, 0);
 	}
-
 	for (c = m->clients; c; c = c->next) {
 		occ |= c->tags;
 		if (c->isurgent)
 			urg |= c->tags;
 	}
-	x = 0;
-	for (i = 0; i < LENGTH(tags); i++) {
-		w = TEXTW(tags[i]);
-		drw_setscheme((*plug).drw, (*plug).scheme[m->tagset[m->seltags] & 1 << i ? SchemeSel : SchemeNorm]);
-		drw_text((*plug).drw, x, 0, w, (*plug).bh, (*plug).lrpad / 2, tags[i], urg & 1 << i);
-		if (occ & 1 << i)
-			drw_rect((*plug).drw, x + boxs, boxs, boxw, boxw,
-				 m == (*plug).selmon && (*plug).selmon->sel && (*plug).selmon->sel->tags & 1 << i,
-				 urg & 1 << i);
-		x += w;
-	}
-	w = TEXTW(m->ltsymbol);
-	drw_setscheme((*plug).drw, (*plug).scheme[SchemeNorm]);
-	x = drw_text((*plug).drw, x, 0, w, (*plug).bh, (*plug).lrpad / 2, m->ltsymbol, 0);
-
-	if ((w = m->ww - tw - x) > (*plug).bh) {
+	if (m == (*plug).selmon) { /* status is only drawn on selected monitor */
+		tw = (*plug).crun.w - 2;
+		if (m->sel)
+			seltags = m->sel->tags;
+	}
+	if (m->sel)
+		titlestate = 1 | m->sel->isfloating << 1 | m->sel->isfixed << 2
+			| (m == (*plug).selmon) << 3;
+
+	dirty = m->bar.dirty;
+	if (m->ww != m->bar.ww) {
+		drw_buf_resize((*plug).drw, m->barbuf, m->ww, (*plug).bh);
+		dirty = ~0;
+	}
+	drw_setbuf((*plug).drw, m->barbuf);
+	if (occ != m->bar.occ || urg != m->bar.urg || seltags != m->bar.seltags
+	    || m->tagset[m->seltags] != m->bar.tagset)
+		dirty |= 1 << BarTags;
+	if (strncmp(m->ltsymbol, m->bar.lt, sizeof m->bar.lt)) {
+		memcpy(m->bar.lt, m->ltsymbol, sizeof m->bar.lt);
+		m->bar.ltw = TEXTW(m->ltsymbol);
+		dirty |= 1 << BarLtSymbol | 1 << BarShelf | 1 << BarTitle;
+	}
+	shelfw = MIN((int)(m->nshelf * shelfslot), MAX(0, m->ww - tw - (int)((*plug).tagsw + m->bar.ltw)));
+	if (shelfw != m->bar.shelfw)
+		dirty |= 1 << BarShelf | 1 << BarTitle;
+	if (m->shelfgen != m->bar.shelfgen)
+		dirty |= 1 << BarShelf;
+	if (tw != m->bar.stw)
+		dirty |= 1 << BarStatus | 1 << BarTitle;
+	if (tw && (*plug).statusgen != m->bar.statusgen)
+		dirty |= 1 << BarStatus;
+	if (m->sel != m->bar.sel || titlestate != m->bar.titlestate
+	    || (m->sel && strcmp(COLD(m->sel)->name, m->bar.title)))
+		dirty |= 1 << BarTitle;
+
+	m->bar.dirty = 0;
+	m->bar.ww = m->ww;
+	m->bar.occ = occ;
+	m->bar.urg = urg;
+	m->bar.seltags = seltags;
+	m->bar.tagset = m->tagset[m->seltags];
+	m->bar.stw = tw;
+	m->bar.shelfw = shelfw;
+	m->bar.shelfgen = m->shelfgen;
+	m->bar.statusgen = (*plug).statusgen;
+	m->bar.sel = m->sel;
+	m->bar.titlestate = titlestate;
+	if (m->sel)
+		strcpy(m->bar.title, COLD(m->sel)->name);
+
+	/* draw status first so it can be overdrawn by tags later */
+	if (dirty & 1 << BarStatus && tw) {
+		drw_setscheme((*plug).drw, (*plug).scheme[SchemeNorm]);
+		drw_run((*plug).drw, m->ww - tw, 0, (*plug).crun.w + (*plug).lrpad, (*plug).bh, 0, &(*plug).crun, 0);
+		drw_map((*plug).drw, m->barwin, m->ww - tw, 0, tw, (*plug).bh);
+	}
+	if (dirty & 1 << BarTags) {
+		for (x = 0, i = 0; i < LENGTH(tags); i++) {
+			w = (*plug).tagw[i];
+			drw_setscheme((*plug).drw, (*plug).scheme[m->tagset[m->seltags] & 1 << i ? SchemeSel : SchemeNorm]);
+			drw_text((*plug).drw, x, 0, w, (*plug).bh, (*plug).lrpad / 2, tags[i], urg & 1 << i);
+			if (occ & 1 << i)
+				drw_rect((*plug).drw, x + boxs, boxs, boxw, boxw, seltags & 1 << i, urg & 1 << i);
+			x += w;
+		}
+		drw_map((*plug).drw, m->barwin, 0, 0, (*plug).tagsw, (*plug).bh);
+	}
+	x = (*plug).tagsw;
+	if (dirty & 1 << BarLtSymbol) {
+		drw_setscheme((*plug).drw, (*plug).scheme[SchemeNorm]);
+		drw_text((*plug).drw, x, 0, m->bar.ltw, (*plug).bh, (*plug).lrpad / 2, m->ltsymbol, 0);
+		drw_map((*plug).drw, m->barwin, x, 0, m->bar.ltw, (*plug).bh);
+	}
+	x += m->bar.ltw;
+	if (dirty & 1 << BarShelf && shelfw) {
+		drw_setscheme((*plug).drw, (*plug).scheme[SchemeNorm]);
+		for (i = 0; i * shelfslot < (unsigned int)shelfw; i++)
+			drw_text((*plug).drw, x + i * shelfslot, 0, MIN(shelfslot, shelfw - i * shelfslot),
+			         (*plug).bh, (*plug).lrpad / 2, COLD(m->shelf[i])->name, 1);
+		drw_map((*plug).drw, m->barwin, x, 0, shelfw, (*plug).bh);
+	}
+	x += shelfw;
+
+	if (dirty & 1 << BarTitle && (w = m->ww - tw - x) > (*plug).bh) {
 		if (m->sel) {
 			drw_setscheme((*plug).drw, (*plug).scheme[m == (*plug).selmon ? SchemeSel : SchemeNorm]);
-			drw_text((*plug).drw, x, 0, w, (*plug).bh, (*plug).lrpad / 2, m->sel->name, 0);
+			drw_text((*plug).drw, x, 0, w, (*plug).bh, (*plug).lrpad / 2, COLD(m->sel)->name, 0);
 			if (m->sel->isfloating)
 				drw_rect((*plug).drw, x + boxs, boxs, boxw, boxw, m->sel->isfixed, 0);
 		} else {
 			drw_setscheme((*plug).drw, (*plug).scheme[SchemeNorm]);
 			drw_rect((*plug).drw, x, 0, w, (*plug).bh, 1, 1);
 		}
+		drw_map((*plug).drw, m->barwin, x, 0, w, (*plug).bh);
 	}
-	drw_map((*plug).drw, m->barwin, 0, 0, m->ww, (*plug).bh);
 }
 
 void
@@ -876,6 +2643,7 @@ __enternotify(XEvent *e)
 		return;
 	focus(c);
 	XRaiseWindow((*plug).dpy, ev->window);
+	m->nstacked = 0; /* the raise may have put a tiled window above the bar */
 	setclientstate(c, NormalState);
 }
 
@@ -885,8 +2653,10 @@ __expose(XEvent *e)
 	Monitor *m;
 	XExposeEvent *ev = &e->xexpose;
 
-	if (ev->count == 0 && (m = wintomon(ev->window)))
+	if (ev->count == 0 && (m = wintomon(ev->window))) {
+		m->bar.dirty = ~0;
 		drawbar(m);
+	}
 }
 
 void
@@ -964,6 +2734,23 @@ __focusstack(const Arg *arg)
 	}
 }
 
+/* Layouts place the visible tiled clients of a monitor in three steps:
+ * gathertiled() collects them into Plug.place, the layout sets each
+ * target and passes it through placehints(), and placeclients()
+ * configures only the clients whose geometry changed. */
+unsigned int
+__gathertiled(Monitor *m)
+{
+	unsigned int n = 0;
+	Client *c;
+
+	for (c = nexttiled(m->clients); c; c = nexttiled(c->next)) {
+		placereserve(n + 1);
+		(*plug).place[n++].c = c;
+	}
+	return (*plug).nplace = n;
+}
+
 Atom
 __getatomprop(Client *c, Atom prop)
 {
@@ -1011,72 +2798,78 @@ __getstate(Window w)
 int
 __gettextprop(Window w, Atom atom, char *text, unsigned int size)
 {
-	char **list = NULL;
-	int n;
 	XTextProperty name;
+	int r;
 
 	if (!text || size == 0)
 		return 0;
 	text[0] = '\0';
-	if (!XGetTextProperty((*plug).dpy, w, &name, atom) || !name.nitems)
+	if (!XGetTextProperty((*plug).dpy, w, &name, atom))
 		return 0;
-	if (name.encoding == XA_STRING) {
-		strncpy(text, (char *)name.value, size - 1);
-	} else if (XmbTextPropertyToTextList((*plug).dpy, &name, &list, &n) >= Success && n > 0 && *list) {
-		strncpy(text, *list, size - 1);
-		XFreeStringList(list);
-	}
-	text[size - 1] = '\0';
+	r = textprop(&name, text, size);
 	XFree(name.value);
-	return 1;
+	return r;
 }
 
+/* The buttons[] of ClkClientWin are grabbed once on the root by grabkeys(),
+ * so all a client needs is the grab of any click while it is unfocused,
+ * which focuses it: one request when that changes, none otherwise. */
 void
 __grabbuttons(Client *c, int focused)
 {
-	updatenumlockmask();
-	{
-		unsigned int i, j;
-		unsigned int modifiers[] = { 0, LockMask, (*plug).numlockmask, (*plug).numlockmask|LockMask };
+	if (c->focusgrab == !focused)
+		return;
+	c->focusgrab = !focused;
+	if (focused)
 		XUngrabButton((*plug).dpy, AnyButton, AnyModifier, c->win);
-		if (!focused)
-			XGrabButton((*plug).dpy, AnyButton, AnyModifier, c->win, False,
-				    BUTTONMASK, GrabModeSync, GrabModeSync, None, None);
-		for (i = 0; i < LENGTH(buttons); i++)
-			if (buttons[i].click == ClkClientWin)
-				for (j = 0; j < LENGTH(modifiers); j++)
-					XGrabButton((*plug).dpy, buttons[i].button,
-						    buttons[i].mask | modifiers[j],
-						    c->win, False, BUTTONMASK,
-						    GrabModeAsync, GrabModeSync, None, None);
-	}
+	else
+		XGrabButton((*plug).dpy, AnyButton, AnyModifier, c->win, False,
+			    BUTTONMASK, GrabModeSync, GrabModeSync, None, None);
 }
 
+/* Run at setup, on MappingNotify and after a reload: numlockmask, the
+ * keymap or keys[] may have changed, grabset() sends only what did. */
 void
 __grabkeys(void)
 {
 	updatenumlockmask();
 	{
-		unsigned int i, j, k;
+		unsigned int i, j, k, n, cap;
 		unsigned int modifiers[] = { 0, LockMask, (*plug).numlockmask, (*plug).numlockmask|LockMask };
 		int start, end, skip;
 		KeySym *syms;
+		uint32_t *want;
 
-		XUngrabKey((*plug).dpy, AnyKey, AnyModifier, (*plug).root);
 		XDisplayKeycodes((*plug).dpy, &start, &end);
 		syms = XGetKeyboardMapping((*plug).dpy, start, end - start + 1, &skip);
 		if (!syms)
 			return;
-		for (k = start; k <= end; k++)
+		for (n = 0, k = start; k <= end; k++)
+			for (i = 0; i < LENGTH(keys); i++)
+				n += keys[i].keysym == syms[(k - start) * skip];
+		for (cap = 16; cap < n * 2; cap *= 2);
+		free((*plug).keytab);
+		(*plug).keytab = ecalloc(cap, sizeof(KeyBind));
+		(*plug).keytabcap = cap;
+		want = ecalloc(n * LENGTH(modifiers) + 1, sizeof *want);
+		for (n = 0, k = start; k <= end; k++)
 			for (i = 0; i < LENGTH(keys); i++)
 				/* skip modifier codes, we do that ourselves */
-				if (keys[i].keysym == syms[(k - start) * skip])
+				if (keys[i].keysym == syms[(k - start) * skip]) {
+					keytabadd(k, CLEANMASK(keys[i].mod), i);
 					for (j = 0; j < LENGTH(modifiers); j++)
-						XGrabKey((*plug).dpy, k,
-							 keys[i].mod | modifiers[j],
-							 (*plug).root, True,
-							 GrabModeAsync, GrabModeAsync);
+						want[n++] = k << 16 | keys[i].mod | modifiers[j];
+				}
 		XFree(syms);
+		grabset(&(*plug).keygrabs, want, n, 0);
+
+		/* the client window buttons, see grabbuttons() */
+		want = ecalloc(LENGTH(buttons) * LENGTH(modifiers) + 1, sizeof *want);
+		for (n = 0, i = 0; i < LENGTH(buttons); i++)
+			if (buttons[i].click == ClkClientWin)
+				for (j = 0; j < LENGTH(modifiers); j++)
+					want[n++] = buttons[i].button << 16 | buttons[i].mask | modifiers[j];
+		grabset(&(*plug).buttongrabs, want, n, 1);
 	}
 }
 
@@ -1102,18 +2895,22 @@ isuniquegeom(XineramaScreenInfo *unique, size_t n, XineramaScreenInfo *info)
 void
 __keypress(XEvent *e)
 {
-	unsigned int i;
-	KeySym keysym;
+	unsigned int i, m, mask, n = 0, hit[8];
 	XKeyEvent *ev;
+	KeyBind *t = (*plug).keytab;
 
+	if (!t)
+		return;
 	ev = &e->xkey;
-	keysym = XKeycodeToKeysym((*plug).dpy, (KeyCode)ev->keycode, 0);
-	for (i = 0; i < LENGTH(keys); i++)
-		if (keysym == keys[i].keysym
-		    && CLEANMASK(keys[i].mod) == CLEANMASK(ev->state)
-		    && keys[i].func
-		    && *keys[i].func)
-			(*keys[i].func)(&(keys[i].arg));
+	mask = CLEANMASK(ev->state);
+	m = (*plug).keytabcap - 1;
+	for (i = keyhash(ev->keycode, mask) & m; t[i].key && n < LENGTH(hit); i = (i + 1) & m)
+		if (t[i].code == ev->keycode && t[i].mask == mask)
+			hit[n++] = t[i].key - 1;
+	/* look up all first, a binding may rebuild the table */
+	for (i = 0; i < n; i++)
+		if (keys[hit[i]].func && *keys[hit[i]].func)
+			(*keys[hit[i]].func)(&(keys[hit[i]].arg));
 }
 
 void
@@ -1138,25 +2935,44 @@ __manage(Window w, XWindowAttributes *wa)
 	Client *c, *t = NULL;
 	Window trans = None;
 	XWindowChanges wc;
+	XSizeHints size;
+	XWMHints wmh;
+	xcb_get_property_reply_t *r[PropLast];
+	char class[1024 + 1], *name = NULL, *res = NULL;
+	int i;
 
-	c = ecalloc(1, sizeof(Client));
+	fetchprops(w, r);
+	c = clientalloc();
 	c->isfloating = 1;
 	c->isfullscreen = 0;
 	c->win = w;
 	/* geometry */
-	c->x = c->oldx = wa->x;
-	c->y = c->oldy = wa->y;
-	c->w = c->oldw = wa->width;
-	c->h = c->oldh = wa->height;
-	c->oldbw = wa->border_width;
-
-	updatetitle(c);
-	if (XGetTransientForHint((*plug).dpy, w, &trans) && (t = wintoclient(trans))) {
+	c->x = COLD(c)->oldx = wa->x;
+	c->y = COLD(c)->oldy = wa->y;
+	c->w = COLD(c)->oldw = wa->width;
+	c->h = COLD(c)->oldh = wa->height;
+	COLD(c)->oldbw = wa->border_width;
+
+	/* what updatetitle(), XGetTransientForHint(), applyrules() and then
+	 * the update*() calls below would each have fetched in turn */
+	if (!proptext(r[PropNetWMName], COLD(c)->name, sizeof COLD(c)->name))
+		proptext(r[PropWMName], COLD(c)->name, sizeof COLD(c)->name);
+	if (COLD(c)->name[0] == '\0') /* hack to mark broken clients */
+		strcpy(COLD(c)->name, (*plug).broken);
+	if ((trans = propcard(r[PropTransient])) && (t = wintoclient(trans))) {
 		c->mon = t->mon;
 		c->tags = t->tags;
 	} else {
 		c->mon = (*plug).selmon;
-		applyrules(c);
+		if (r[PropClass] && r[PropClass]->format == 8) {
+			i = MIN(xcb_get_property_value_length(r[PropClass]), sizeof class - 1);
+			memcpy(class, xcb_get_property_value(r[PropClass]), i);
+			class[i] = '\0';
+			name = class; /* instance, then class, each NUL-terminated */
+			if (strlen(name) + 1 < (size_t)i)
+				res = name + strlen(name) + 1;
+		}
+		matchrules(c, res, name);
 	}
 
 	if (c->x + WIDTH(c) > c->mon->wx + c->mon->ww)
@@ -1171,9 +2987,14 @@ __manage(Window w, XWindowAttributes *wa)
 	XConfigureWindow((*plug).dpy, w, CWBorderWidth, &wc);
 	XSetWindowBorder((*plug).dpy, w, (*plug).scheme[SchemeNorm][ColBorder].pixel);
 	configure(c); /* propagates border_width, if size doesn't change */
-	updatewindowtype(c);
-	updatesizehints(c);
-	updatewmhints(c);
+	setwindowtype(c, propcard(r[PropNetWMState]), propcard(r[PropNetWMWindowType]));
+	if (!propsizehints(r[PropNormalHints], &size))
+		size.flags = PSize;
+	setsizehints(c, &size);
+	if (propwmhints(r[PropHints], &wmh))
+		setwmhints(c, &wmh);
+	for (i = 0; i < PropLast; i++)
+		free(r[i]);
 	XSelectInput((*plug).dpy, w, EnterWindowMask|FocusChangeMask|PropertyChangeMask|StructureNotifyMask);
 	grabbuttons(c, 0);
 	if (!c->isfloating)
@@ -1182,8 +3003,9 @@ __manage(Window w, XWindowAttributes *wa)
 		XRaiseWindow((*plug).dpy, c->win);
 	attach(c);
 	attachstack(c);
-	XChangeProperty((*plug).dpy, (*plug).root, (*plug).netatom[NetClientList], XA_WINDOW, 32, PropModeAppend,
-			(unsigned char *) &(c->win), 1);
+	wintabadd(c);
+	clientlistadd(c->win);
+	updateclientlist();
 	XMoveResizeWindow((*plug).dpy, c->win, c->x + 2 * (*plug).sw, c->y, c->w, c->h); /* some windows require this */
 	setclientstate(c, NormalState);
 	if (c->mon == (*plug).selmon)
@@ -1200,8 +3022,8 @@ __mappingnotify(XEvent *e)
 	XMappingEvent *ev = &e->xmapping;
 
 	XRefreshKeyboardMapping(ev);
-	if (ev->request == MappingKeyboard)
-		grabkeys();
+	if (ev->request == MappingKeyboard || ev->request == MappingModifier)
+		grabkeys(); /* and with them the keytab, numlockmask may move too */
 }
 
 void
@@ -1220,14 +3042,22 @@ __monocle(Monitor *m)
 {
 	unsigned int n = 0;
 	Client *c;
+	Place *p;
 
 	for (c = m->clients; c; c = c->next)
 		if (ISVISIBLE(c))
 			n++;
 	if (n > 0) /* override layout symbol */
 		snprintf(m->ltsymbol, sizeof m->ltsymbol, "[%d]", n);
-	for (c = nexttiled(m->clients); c; c = nexttiled(c->next))
-		resize(c, m->wx, m->wy, m->ww - 2 * c->bw, m->wh - 2 * c->bw, 0);
+	n = gathertiled(m);
+	for (p = (*plug).place; p < (*plug).place + n; p++) {
+		p->x = m->wx;
+		p->y = m->wy;
+		p->w = m->ww - 2 * p->c->bw;
+		p->h = m->wh - 2 * p->c->bw;
+		placehints(p);
+	}
+	placeclients(n);
 }
 
 void
@@ -1252,8 +3082,7 @@ __movemouse(const Arg *arg)
 	int x, y, ocx, ocy, nx, ny;
 	Client *c;
 	Monitor *m;
-	XEvent ev;
-	Time lasttime = 0;
+	Drag drag;
 
 	if (!(c = (*plug).selmon->sel))
 		return;
@@ -1261,67 +3090,32 @@ __movemouse(const Arg *arg)
 		return;
 	restack((*plug).selmon);
 	ocx = c->x;
-	ocy = c->y;
-	if (XGrabPointer((*plug).dpy, (*plug).root, False, MOUSEMASK, GrabModeAsync, GrabModeAsync,
-			 None, (*plug).cursor[CurMove]->cursor, CurrentTime) != GrabSuccess)
-		return;
-	if (!getrootptr(&x, &y))
-		return;
-	do {
-		XMaskEvent((*plug).dpy, MOUSEMASK|ExposureMask|SubstructureRedirectMask, &ev);
-		switch(ev.type) {
-		case ConfigureRequest:
-		case Expose:
-		case MapRequest:
-			(*plug).handler[ev.type](&ev);
-			break;
-		case MotionNotify:
-			if ((ev.xmotion.time - lasttime) <= (1000 / 60))
-				continue;
-			lasttime = ev.xmotion.time;
-
-			nx = ocx + (ev.xmotion.x - x);
-			ny = ocy + (ev.xmotion.y - y);
-			if (abs((*plug).selmon->wx - nx) < snap)
-				nx = (*plug).selmon->wx;
-			else if (abs(((*plug).selmon->wx + (*plug).selmon->ww) - (nx + WIDTH(c))) < snap)
-				nx = (*plug).selmon->wx + (*plug).selmon->ww - WIDTH(c);
-			if (abs((*plug).selmon->wy - ny) < snap)
-				ny = (*plug).selmon->wy;
-			else if (abs(((*plug).selmon->wy + (*plug).selmon->wh) - (ny + HEIGHT(c))) < snap)
-				ny = (*plug).selmon->wy + (*plug).selmon->wh - HEIGHT(c);
-			Client *d = (*plug).selmon->clients;
-			while (d) {
-				if (d != c) {
-					if (abs(d->x - nx) < snap) {
-						nx = d->x;
-					}
-					if (abs((d->x - c->w) - nx) < snap) {
-						nx = d->x - c->w;
-					}
-					if (abs((d->x + c->w) - nx) < snap) {
-						nx = d->x + c->w;
-					}
-					if (abs(d->y - ny) < snap) {
-						ny = d->y;
-					}
-					if (abs((d->y - c->h) - ny) < snap) {
-						ny = d->y - c->h;
-					}
-					if (abs((d->y + c->h) - ny) < snap) {
-						ny = d->y + c->h;
-					}
-				}
-				d = d->next;
-			}
-			if (!c->isfloating && (*plug).selmon->lt[(*plug).selmon->sellt]->arrange
-			    && (abs(nx - c->x) > snap || abs(ny - c->y) > snap))
-				togglefloating(NULL);
-			if (!(*plug).selmon->lt[(*plug).selmon->sellt]->arrange || c->isfloating)
-				resize(c, nx, ny, c->w, c->h, 1);
-			break;
+	ocy = c->y;
+	if (XGrabPointer((*plug).dpy, (*plug).root, False, MOUSEMASK, GrabModeAsync, GrabModeAsync,
+			 None, (*plug).cursor[CurMove]->cursor, CurrentTime) != GrabSuccess)
+		return;
+	if (!getrootptr(&x, &y))
+		return;
+	dragbegin(&drag, c, 0);
+	snapbuild(&drag, (*plug).selmon);
+	while (dragnext(&drag)) {
+		nx = snapto(drag.snapx, drag.nsnap, ocx + (drag.x - x));
+		ny = snapto(drag.snapy, drag.nsnap, ocy + (drag.y - y));
+		if (!c->isfloating && (*plug).selmon->lt[(*plug).selmon->sellt]->arrange
+		    && (abs(nx - c->x) > snap || abs(ny - c->y) > snap)) {
+			togglefloating(NULL);
+			/* arrange() moved the others, snap to where they are now */
+			free(drag.snapx);
+			free(drag.snapy);
+			snapbuild(&drag, (*plug).selmon);
+			nx = snapto(drag.snapx, drag.nsnap, ocx + (drag.x - x));
+			ny = snapto(drag.snapy, drag.nsnap, ocy + (drag.y - y));
 		}
-	} while (ev.type != ButtonRelease);
+		if (!(*plug).selmon->lt[(*plug).selmon->sellt]->arrange || c->isfloating)
+			resize(c, nx, ny, c->w, c->h, 1);
+	}
+	free(drag.snapx);
+	free(drag.snapy);
 	XUngrabPointer((*plug).dpy, CurrentTime);
 	if ((m = recttomon(c->x, c->y, c->w, c->h)) != (*plug).selmon) {
 		sendmon(c, m);
@@ -1337,6 +3131,24 @@ __nexttiled(Client *c)
 	return c;
 }
 
+void
+__placeclients(unsigned int n)
+{
+	Place *p;
+
+	for (p = (*plug).place; p < (*plug).place + n; p++)
+		if (p->x != p->c->x || p->y != p->c->y || p->w != p->c->w || p->h != p->c->h)
+			resizeclient(p->c, p->x, p->y, p->w, p->h);
+}
+
+/* apply the size hints of its client to p, returning its outer height */
+int
+__placehints(Place *p)
+{
+	applysizehints(p->c, &p->x, &p->y, &p->w, &p->h, 0);
+	return p->h + 2 * p->c->bw;
+}
+
 void
 __pop(Client *c)
 {
@@ -1362,8 +3174,10 @@ __propertynotify(XEvent *e)
 		default: break;
 		case XA_WM_TRANSIENT_FOR:
 			if (!c->isfloating && (XGetTransientForHint((*plug).dpy, c->win, &trans)) &&
-			    (c->isfloating = (wintoclient(trans)) != NULL))
+			    (c->isfloating = (wintoclient(trans)) != NULL)) {
+				(*plug).clientgen++;
 				arrange(c->mon);
+			}
 			break;
 		case XA_WM_NORMAL_HINTS:
 			c->hintsvalid = 0;
@@ -1375,7 +3189,9 @@ __propertynotify(XEvent *e)
 		}
 		if (ev->atom == XA_WM_NAME || ev->atom == (*plug).netatom[NetWMName]) {
 			updatetitle(c);
-			if (c == c->mon->sel)
+			if (c->isminimized)
+				c->mon->shelfgen++;
+			if (c == c->mon->sel || c->isminimized)
 				drawbar(c->mon);
 		}
 		if (ev->atom == (*plug).netatom[NetWMWindowType])
@@ -1389,6 +3205,28 @@ __quit(const Arg *arg)
 	(*plug).running = 0;
 }
 
+void
+__readctl(void)
+{
+	char buf[64];
+	ssize_t i, n;
+
+	while ((n = read((*plug).ctlpipe[0], buf, sizeof buf)) > 0)
+		for (i = 0; i < n; i++)
+			ctlmsg(&buf[i], 1);
+}
+
+/* status producers and dwmc(1) send one message per datagram, see ctlmsg() */
+void
+__readsock(void)
+{
+	char buf[2 + sizeof *(*plug).stext];
+	ssize_t n;
+
+	while ((n = recv((*plug).sockfd, buf, sizeof buf, 0)) > 0)
+		ctlmsg(buf, n);
+}
+
 Monitor *
 __recttomon(int x, int y, int w, int h)
 {
@@ -1415,24 +3253,24 @@ __resizeclient(Client *c, int x, int y, int w, int h)
 {
 	XWindowChanges wc;
 
-	c->oldx = c->x; c->x = wc.x = x;
-	c->oldy = c->y; c->y = wc.y = y;
-	c->oldw = c->w; c->w = wc.width = w;
-	c->oldh = c->h; c->h = wc.height = h;
+	COLD(c)->oldx = c->x; c->x = wc.x = x;
+	COLD(c)->oldy = c->y; c->y = wc.y = y;
+	COLD(c)->oldw = c->w; c->w = wc.width = w;
+	COLD(c)->oldh = c->h; c->h = wc.height = h;
 	wc.border_width = c->bw;
 	XConfigureWindow((*plug).dpy, c->win, CWX|CWY|CWWidth|CWHeight|CWBorderWidth, &wc);
 	configure(c);
-	XSync((*plug).dpy, False);
+	XSYNC((*plug).dpy);
 }
 
 void
 __resizemouse(const Arg *arg)
 {
-	int ocx, ocy, nw, nh;
+	int ocx, ocy, nx, ny, nw, nh;
 	Client *c;
 	Monitor *m;
 	XEvent ev;
-	Time lasttime = 0;
+	Drag drag;
 
 	if (!(c = (*plug).selmon->sel))
 		return;
@@ -1445,33 +3283,26 @@ __resizemouse(const Arg *arg)
 			 None, (*plug).cursor[CurResize]->cursor, CurrentTime) != GrabSuccess)
 		return;
 	XWarpPointer((*plug).dpy, None, c->win, 0, 0, 0, 0, c->w + c->bw - 1, c->h + c->bw - 1);
-	do {
-		XMaskEvent((*plug).dpy, MOUSEMASK|ExposureMask|SubstructureRedirectMask, &ev);
-		switch(ev.type) {
-		case ConfigureRequest:
-		case Expose:
-		case MapRequest:
-			(*plug).handler[ev.type](&ev);
-			break;
-		case MotionNotify:
-			if ((ev.xmotion.time - lasttime) <= (1000 / 60))
-				continue;
-			lasttime = ev.xmotion.time;
-
-			nw = MAX(ev.xmotion.x - ocx - 2 * c->bw + 1, 1);
-			nh = MAX(ev.xmotion.y - ocy - 2 * c->bw + 1, 1);
-			if (c->mon->wx + nw >= (*plug).selmon->wx && c->mon->wx + nw <= (*plug).selmon->wx + (*plug).selmon->ww
-			    && c->mon->wy + nh >= (*plug).selmon->wy && c->mon->wy + nh <= (*plug).selmon->wy + (*plug).selmon->wh)
-			{
-				if (!c->isfloating && (*plug).selmon->lt[(*plug).selmon->sellt]->arrange
-				    && (abs(nw - c->w) > snap || abs(nh - c->h) > snap))
-					togglefloating(NULL);
+	dragbegin(&drag, c, 1);
+	while (dragnext(&drag)) {
+		nw = MAX(drag.x - ocx - 2 * c->bw + 1, 1);
+		nh = MAX(drag.y - ocy - 2 * c->bw + 1, 1);
+		if (c->mon->wx + nw >= (*plug).selmon->wx && c->mon->wx + nw <= (*plug).selmon->wx + (*plug).selmon->ww
+		    && c->mon->wy + nh >= (*plug).selmon->wy && c->mon->wy + nh <= (*plug).selmon->wy + (*plug).selmon->wh)
+		{
+			if (!c->isfloating && (*plug).selmon->lt[(*plug).selmon->sellt]->arrange
+			    && (abs(nw - c->w) > snap || abs(nh - c->h) > snap))
+				togglefloating(NULL);
+		}
+		if (!(*plug).selmon->lt[(*plug).selmon->sellt]->arrange || c->isfloating) {
+			nx = c->x;
+			ny = c->y;
+			if (applysizehints(c, &nx, &ny, &nw, &nh, 1)) {
+				dragsync(&drag); /* ahead of the configure it is about */
+				resizeclient(c, nx, ny, nw, nh);
 			}
-			if (!(*plug).selmon->lt[(*plug).selmon->sellt]->arrange || c->isfloating)
-				resize(c, c->x, c->y, nw, nh, 1);
-			break;
 		}
-	} while (ev.type != ButtonRelease);
+	}
 	XWarpPointer((*plug).dpy, None, c->win, 0, 0, 0, 0, c->w + c->bw - 1, c->h + c->bw - 1);
 	XUngrabPointer((*plug).dpy, CurrentTime);
 	while (XCheckMaskEvent((*plug).dpy, EnterWindowMask, &ev));
@@ -1485,70 +3316,184 @@ __resizemouse(const Arg *arg)
 void
 __restack(Monitor *m)
 {
-	Client *c;
 	XEvent ev;
-	XWindowChanges wc;
+	int raise;
 
 	drawbar(m);
 	if (!m->sel)
 		return;
-	if (m->sel->isfloating || !m->lt[m->sellt]->arrange)
+	if ((raise = m->sel->isfloating || !m->lt[m->sellt]->arrange))
 		XRaiseWindow((*plug).dpy, m->sel->win);
-	if (m->lt[m->sellt]->arrange) {
-		wc.stack_mode = Below;
-		wc.sibling = m->barwin;
-		for (c = m->stack; c; c = c->snext)
-			if (!c->isfloating && ISVISIBLE(c)) {
-				XConfigureWindow((*plug).dpy, c->win, CWSibling|CWStackMode, &wc);
-				wc.sibling = c->win;
-			}
-	}
+	if (!m->lt[m->sellt]->arrange)
+		m->nstacked = 0; /* anything may be raised now */
+	else if (!restackdiff(m) && !raise)
+		return; /* nothing moved, no EnterNotify to drop */
 	XSync((*plug).dpy, False);
 	while (XCheckMaskEvent((*plug).dpy, EnterWindowMask, &ev));
+	(*plug).dropenter = 1; /* and those already read into the batch */
 }
 
 void
 __run(void)
 {
-	XEvent ev;
+	XEvent ev[BATCHLEN];
+	int i, n;
+	uint64_t expirations;
+	struct pollfd pfd[] = {
+		{ .fd = (*plug).xfd,        .events = POLLIN },
+		{ .fd = (*plug).tfd,        .events = POLLIN },
+		{ .fd = (*plug).ctlpipe[0], .events = POLLIN },
+		{ .fd = -1,                 .events = POLLIN }, /* buildfd */
+		{ .fd = (*plug).sockfd,     .events = POLLIN },
+	};
+
 	/* main event loop */
 	XSync((*plug).dpy, False);
 	while ((*plug).running) {
-		if (XPending(plug->dpy) > 0) {
-			XNextEvent((*plug).dpy, &ev);
-			// printf("%d\n", ev.type);
-			if ((*plug).handler[ev.type])
-				(*plug).handler[ev.type](&ev); /* call handler */
+		/* drain everything Xlib has queued or can read without blocking
+		 * into batches, coalesce and dispatch each with the bars drawn
+		 * once at its end, then flush the requests once and sleep until
+		 * something happens */
+		for (n = 0; n < BATCHLEN && (XEventsQueued((*plug).dpy, QueuedAlready)
+		     || XEventsQueued((*plug).dpy, QueuedAfterReading)); n++) {
+			XNextEvent((*plug).dpy, &ev[n]);
+#ifdef XRANDR
+			if ((*plug).rrbase != -1 && (ev[n].type == (*plug).rrbase + RRScreenChangeNotify
+			    || ev[n].type == (*plug).rrbase + RRNotify))
+				rrconfigure(&ev[n]);
+#endif /* XRANDR */
+			if (ev[n].type == KeyPress || ev[n].type == ButtonPress) {
+				n++;
+				break; /* its handler may grab and read on by itself */
+			}
+		}
+		if (n) {
+			coalesce(ev, n);
+			(*plug).batching = 1;
+			(*plug).dropenter = 0;
+			for (i = 0; i < n && (*plug).running; i++) {
+				if (ev[i].type == EnterNotify && (*plug).dropenter)
+					continue;
+				if (i == n - 1 && (ev[i].type == KeyPress || ev[i].type == ButtonPress))
+					drawqueued(); /* a grab loop draws on its own */
+				if (ev[i].type && ev[i].type < LASTEvent && (*plug).handler[ev[i].type])
+					TRACED(ev[i].type, (*plug).handler[ev[i].type](&ev[i])); /* call handler */
+			}
+			drawqueued();
+			continue;
+		}
+		XFlush((*plug).dpy);
+		pfd[3].fd = (*plug).buildfd; /* poll() skips it while -1 */
+		if (poll(pfd, LENGTH(pfd), -1) == -1) {
+			if (errno == EINTR)
+				continue;
+			die("dwm: poll:");
 		}
-	        // drawbars();
+		if (pfd[1].revents & POLLIN
+		    && read((*plug).tfd, &expirations, sizeof expirations) > 0)
+			runtimers();
+		if (pfd[2].revents & POLLIN)
+			readctl();
+		if (pfd[3].revents & (POLLIN | POLLHUP))
+			builddone(); /* swaps builds between two batches */
+		if (pfd[4].revents & POLLIN)
+			readsock();
 	}
 }
 
 void
-__scan(void)
+__runtimers(void)
 {
-	unsigned int i, num;
-	Window d1, d2, *wins = NULL;
-	XWindowAttributes wa;
+	Timer t;
+	uint64_t now = monotime();
+
+	while ((*plug).ntimers && (*plug).timers[0].deadline <= now) {
+		t = (*plug).timers[0];
+		/* reschedule before calling, so the callback may delete or
+		 * re-arm its own timer */
+		if (t.interval) {
+			(*plug).timers[0].deadline = MAX(t.deadline + t.interval, now + 1);
+			timersift(0);
+		} else
+			deltimer(t.id);
+		if (*t.func)
+			(*t.func)();
+	}
+	timerarm();
+}
 
-	if (XQueryTree((*plug).dpy, (*plug).root, &d1, &d2, &wins, &num)) {
-		for (i = 0; i < num; i++) {
-			if (!XGetWindowAttributes((*plug).dpy, wins[i], &wa)
-			    || wa.override_redirect || XGetTransientForHint((*plug).dpy, wins[i], &d1))
-				continue;
-			if (wa.map_state == IsViewable || getstate(wins[i]) == IconicState)
-				manage(wins[i], &wa);
+void
+__scan(void)
+{
+	xcb_connection_t *xc = XGetXCBConnection((*plug).dpy);
+	xcb_query_tree_reply_t *tree;
+	xcb_get_window_attributes_reply_t *a;
+	xcb_get_geometry_reply_t *g;
+	xcb_get_property_reply_t *p;
+	xcb_window_t *wins;
+	struct {
+		xcb_get_window_attributes_cookie_t attr;
+		xcb_get_geometry_cookie_t geom;
+		xcb_get_property_cookie_t state, trans;
+	} *ck;
+	XWindowAttributes *wa;
+	unsigned char *pass; /* 1 to manage at once, 2 for transients, 0 not */
+	long state;
+	int i, n, trans;
+
+	if (!(tree = xcb_query_tree_reply(xc, xcb_query_tree(xc, (*plug).root), NULL)))
+		return;
+	n = xcb_query_tree_children_length(tree);
+	wins = xcb_query_tree_children(tree);
+	ck = ecalloc(n + 1, sizeof *ck);
+	wa = ecalloc(n + 1, sizeof *wa);
+	pass = ecalloc(n + 1, 1);
+	/* send the requests for all windows before waiting for any reply,
+	 * so the whole tree costs about one round trip */
+	for (i = 0; i < n; i++) {
+		ck[i].attr = xcb_get_window_attributes(xc, wins[i]);
+		ck[i].geom = xcb_get_geometry(xc, wins[i]);
+		ck[i].state = xcb_get_property(xc, 0, wins[i], (*plug).wmatom[WMState],
+		                               (*plug).wmatom[WMState], 0, 2);
+		ck[i].trans = xcb_get_property(xc, 0, wins[i], XA_WM_TRANSIENT_FOR, XA_WINDOW, 0, 1);
+	}
+	for (i = 0; i < n; i++) {
+		a = xcb_get_window_attributes_reply(xc, ck[i].attr, NULL);
+		g = xcb_get_geometry_reply(xc, ck[i].geom, NULL);
+		state = -1;
+		if ((p = xcb_get_property_reply(xc, ck[i].state, NULL))) {
+			if (p->format == 32 && p->value_len)
+				state = *(uint32_t *)xcb_get_property_value(p);
+			free(p);
 		}
-		for (i = 0; i < num; i++) { /* now the transients */
-			if (!XGetWindowAttributes((*plug).dpy, wins[i], &wa))
-				continue;
-			if (XGetTransientForHint((*plug).dpy, wins[i], &d1)
-			    && (wa.map_state == IsViewable || getstate(wins[i]) == IconicState))
-				manage(wins[i], &wa);
+		trans = 0;
+		if ((p = xcb_get_property_reply(xc, ck[i].trans, NULL))) {
+			trans = p->format == 32 && p->value_len;
+			free(p);
 		}
-		if (wins)
-			XFree(wins);
+		if (a && g && !a->override_redirect
+		    && (a->map_state == XCB_MAP_STATE_VIEWABLE || state == IconicState)) {
+			wa[i].x = g->x;
+			wa[i].y = g->y;
+			wa[i].width = g->width;
+			wa[i].height = g->height;
+			wa[i].border_width = g->border_width;
+			wa[i].map_state = a->map_state;
+			pass[i] = trans ? 2 : 1;
+		}
+		free(a);
+		free(g);
 	}
+	for (i = 0; i < n; i++)
+		if (pass[i] == 1)
+			manage(wins[i], &wa[i]);
+	for (i = 0; i < n; i++) /* now the transients */
+		if (pass[i] == 2)
+			manage(wins[i], &wa[i]);
+	free(pass);
+	free(wa);
+	free(ck);
+	free(tree);
 }
 
 void
@@ -1559,6 +3504,7 @@ __sendmon(Client *c, Monitor *m)
 	unfocus(c, 1);
 	detach(c);
 	detachstack(c);
+	c->mon->nstacked = m->nstacked = 0; /* c leaves one stacking, joins another */
 	c->mon = m;
 	c->tags = m->tagset[m->seltags]; /* assign tags of target monitor */
 	attach(c);
@@ -1616,26 +3562,31 @@ __setfocus(Client *c)
 void
 __setfullscreen(Client *c, int fullscreen)
 {
+	ClientCold *cc = COLD(c);
+
 	if (fullscreen && !c->isfullscreen) {
 		XChangeProperty((*plug).dpy, c->win, (*plug).netatom[NetWMState], XA_ATOM, 32,
 				PropModeReplace, (unsigned char*)&(*plug).netatom[NetWMFullscreen], 1);
 		c->isfullscreen = 1;
 		c->oldstate = c->isfloating;
-		c->oldbw = c->bw;
+		cc->oldbw = c->bw;
 		c->bw = 0;
 		c->isfloating = 1;
+		(*plug).clientgen++;
 		resizeclient(c, c->mon->mx, c->mon->my, c->mon->mw, c->mon->mh);
 		XRaiseWindow((*plug).dpy, c->win);
+		c->mon->nstacked = 0; /* c is no longer where restack() put it */
 	} else if (!fullscreen && c->isfullscreen){
 		XChangeProperty((*plug).dpy, c->win, (*plug).netatom[NetWMState], XA_ATOM, 32,
 				PropModeReplace, (unsigned char*)0, 0);
 		c->isfullscreen = 0;
 		c->isfloating = c->oldstate;
-		c->bw = c->oldbw;
-		c->x = c->oldx;
-		c->y = c->oldy;
-		c->w = c->oldw;
-		c->h = c->oldh;
+		c->bw = cc->oldbw;
+		(*plug).clientgen++;
+		c->x = cc->oldx;
+		c->y = cc->oldy;
+		c->w = cc->oldw;
+		c->h = cc->oldh;
 		resizeclient(c, c->x, c->y, c->w, c->h);
 		arrange(c->mon);
 	}
@@ -1670,10 +3621,24 @@ __setmfact(const Arg *arg)
 	arrange((*plug).selmon);
 }
 
+/* move the next expiration of timer id to ms from now */
 void
-__setup(void)
+__settimer(int id, unsigned int ms)
 {
 	int i;
+
+	if (id < 0 || id >= MAXTIMERS || !(*plug).timerslot[id])
+		return;
+	i = (*plug).timerslot[id] - 1;
+	(*plug).timers[i].deadline = monotime() + ms;
+	timersift(i);
+	timerarm();
+}
+
+void
+__setup(void)
+{
+	int i, j;
 	XSetWindowAttributes wa;
 	Atom utf8string;
 	struct sigaction sa;
@@ -1687,16 +3652,45 @@ __setup(void)
 	/* clean up any zombies (inherited from .xinitrc etc) immediately */
 	while (waitpid(-1, NULL, WNOHANG) > 0);
 
+	/* event loop descriptors: SIGHUP, SIGTERM (and SIGUSR1) are turned into control
+	 * messages on the self-pipe, so they are handled between batches */
+	if (pipe2((*plug).ctlpipe, O_NONBLOCK | O_CLOEXEC) == -1)
+		die("pipe2:");
+	sa.sa_flags = SA_RESTART;
+	sa.sa_handler = sigctl;
+	sigaction(SIGHUP, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+#ifdef TRACE
+	sigaction(SIGUSR1, &sa, NULL); /* write the trace, see tracedump() */
+#endif
+	if (((*plug).tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) == -1)
+		die("timerfd_create:");
+	opensock();
+
 	/* init screen */
 	(*plug).screen = DefaultScreen((*plug).dpy);
 	(*plug).sw = DisplayWidth((*plug).dpy, (*plug).screen);
 	(*plug).sh = DisplayHeight((*plug).dpy, (*plug).screen);
 	(*plug).root = RootWindow((*plug).dpy, (*plug).screen);
-	(*plug).drw = drw_create((*plug).dpy, (*plug).screen, (*plug).root, (*plug).sw, (*plug).sh);
+	(*plug).xfd = ConnectionNumber((*plug).dpy);
+	(*plug).havesync = XSyncQueryExtension((*plug).dpy, &i, &j)
+	                   && XSyncInitialize((*plug).dpy, &i, &j);
+#ifdef XRANDR
+	/* monitors by name need RandR 1.5, updategeom() falls back to Xinerama */
+	if (XRRQueryExtension((*plug).dpy, &(*plug).rrbase, &i)
+	    && XRRQueryVersion((*plug).dpy, &i, &j) && (i > 1 || (i == 1 && j >= 5)))
+		XRRSelectInput((*plug).dpy, (*plug).root, RRScreenChangeNotifyMask
+		               | RRCrtcChangeNotifyMask | RROutputChangeNotifyMask);
+	else
+		(*plug).rrbase = -1;
+#endif /* XRANDR */
+	(*plug).drw = drw_create((*plug).dpy, (*plug).screen, (*plug).root);
 	if (!drw_fontset_create((*plug).drw, fonts, LENGTH(fonts)))
 		die("no fonts could be loaded.");
 	(*plug).lrpad = (*plug).drw->fonts->h;
 	(*plug).bh = (*plug).drw->fonts->h + 2;
+	for ((*plug).tagsw = i = 0; i < LENGTH(tags); i++)
+		(*plug).tagsw += (*plug).tagw[i] = TEXTW(tags[i]);
 	updategeom();
 	/* init atoms */
 	utf8string = XInternAtom((*plug).dpy, "UTF8_STRING", False);
@@ -1713,6 +3707,8 @@ __setup(void)
 	(*plug).netatom[NetWMWindowType] = XInternAtom((*plug).dpy, "_NET_WM_WINDOW_TYPE", False);
 	(*plug).netatom[NetWMWindowTypeDialog] = XInternAtom((*plug).dpy, "_NET_WM_WINDOW_TYPE_DIALOG", False);
 	(*plug).netatom[NetClientList] = XInternAtom((*plug).dpy, "_NET_CLIENT_LIST", False);
+	(*plug).netatom[NetWMSyncRequest] = XInternAtom((*plug).dpy, "_NET_WM_SYNC_REQUEST", False);
+	(*plug).netatom[NetWMSyncRequestCounter] = XInternAtom((*plug).dpy, "_NET_WM_SYNC_REQUEST_COUNTER", False);
 	/* init cursors */
 	(*plug).cursor[CurNormal] = drw_cur_create((*plug).drw, XC_left_ptr);
 	(*plug).cursor[CurResize] = drw_cur_create((*plug).drw, XC_sizing);
@@ -1724,6 +3720,8 @@ __setup(void)
 	/* init bars */
 	updatebars();
 	updatestatus();
+	updateclock((*plug).clocksec = time(NULL));
+	(*plug).clocktimer = addtimer(0, 1000, &clocktick);
 	/* supporting window for NetWMCheck */
 	(*plug).wmcheckwin = XCreateSimpleWindow((*plug).dpy, (*plug).root, 0, 0, 1, 1, 0, 0, 0);
 	XChangeProperty((*plug).dpy, (*plug).wmcheckwin, (*plug).netatom[NetWMCheck], XA_WINDOW, 32,
@@ -1744,6 +3742,7 @@ __setup(void)
 	XChangeWindowAttributes((*plug).dpy, (*plug).root, CWEventMask|CWCursor, &wa);
 	XSelectInput((*plug).dpy, (*plug).root, wa.event_mask);
 	grabkeys();
+	compilerules();
 	focus(NULL);
 }
 
@@ -1763,19 +3762,33 @@ __seturgent(Client *c, int urg)
 void
 __showhide(Client *c)
 {
-	if (!c)
+	unsigned int i, n = 0;
+	Place *p;
+
+	/* collect the stack in Plug.place first, layouts only use it later */
+	for (; c; c = c->snext) {
+		placereserve(n + 1);
+		(*plug).place[n++].c = c;
+	}
+	if (!n)
 		return;
-	if (ISVISIBLE(c)) {
-		/* show clients top down */
+	XGrabServer((*plug).dpy); /* show the switch as one update */
+	/* show clients top down */
+	for (p = (*plug).place; p < (*plug).place + n; p++) {
+		c = p->c;
+		if (!ISVISIBLE(c))
+			continue;
 		XMoveWindow((*plug).dpy, c->win, c->x, c->y);
 		if ((!c->mon->lt[c->mon->sellt]->arrange || c->isfloating) && !c->isfullscreen)
 			resize(c, c->x, c->y, c->w, c->h, 0);
-		showhide(c->snext);
-	} else {
-		/* hide clients bottom up */
-		showhide(c->snext);
-		XMoveWindow((*plug).dpy, c->win, WIDTH(c) * -2, c->y);
 	}
+	/* hide clients bottom up */
+	for (i = n; i--; ) {
+		c = (*plug).place[i].c;
+		if (!ISVISIBLE(c))
+			XMoveWindow((*plug).dpy, c->win, WIDTH(c) * -2, c->y);
+	}
+	XUngrabServer((*plug).dpy);
 }
 
 void
@@ -1805,6 +3818,7 @@ __tag(const Arg *arg)
 {
 	if ((*plug).selmon->sel && arg->ui & TAGMASK) {
 		(*plug).selmon->sel->tags = arg->ui & TAGMASK;
+		(*plug).clientgen++;
 		focus(NULL);
 		arrange((*plug).selmon);
 	}
@@ -1822,28 +3836,36 @@ void
 __tile(Monitor *m)
 {
 	unsigned int i, n, h, mw, my, ty;
-	Client *c;
+	Place *p;
 
-	for (n = 0, c = nexttiled(m->clients); c; c = nexttiled(c->next), n++);
-	if (n == 0)
+	if ((n = gathertiled(m)) == 0)
 		return;
 
 	if (n > m->nmaster)
 		mw = m->nmaster ? m->ww * m->mfact : 0;
 	else
 		mw = m->ww;
-	for (i = my = ty = 0, c = nexttiled(m->clients); c; c = nexttiled(c->next), i++)
+	for (i = my = ty = 0; i < n; i++) {
+		p = &(*plug).place[i];
 		if (i < m->nmaster) {
 			h = (m->wh - my) / (MIN(n, m->nmaster) - i);
-			resize(c, m->wx, m->wy + my, mw - (2*c->bw), h - (2*c->bw), 0);
-			if (my + HEIGHT(c) < m->wh)
-				my += HEIGHT(c);
+			p->x = m->wx;
+			p->y = m->wy + my;
+			p->w = mw - (2*p->c->bw);
+			p->h = h - (2*p->c->bw);
+			if (my + (h = placehints(p)) < m->wh)
+				my += h;
 		} else {
 			h = (m->wh - ty) / (n - i);
-			resize(c, m->wx + mw, m->wy + ty, m->ww - mw - (2*c->bw), h - (2*c->bw), 0);
-			if (ty + HEIGHT(c) < m->wh)
-				ty += HEIGHT(c);
+			p->x = m->wx + mw;
+			p->y = m->wy + ty;
+			p->w = m->ww - mw - (2*p->c->bw);
+			p->h = h - (2*p->c->bw);
+			if (ty + (h = placehints(p)) < m->wh)
+				ty += h;
 		}
+	}
+	placeclients(n);
 }
 
 void
@@ -1863,6 +3885,7 @@ __togglefloating(const Arg *arg)
 	if ((*plug).selmon->sel->isfullscreen) /* no support for fullscreen windows */
 		return;
 	(*plug).selmon->sel->isfloating = !(*plug).selmon->sel->isfloating || (*plug).selmon->sel->isfixed;
+	(*plug).clientgen++;
 	if ((*plug).selmon->sel->isfloating)
 		resize((*plug).selmon->sel, (*plug).selmon->sel->x, (*plug).selmon->sel->y,
 		       (*plug).selmon->sel->w, (*plug).selmon->sel->h, 0);
@@ -1879,6 +3902,7 @@ __toggletag(const Arg *arg)
 	newtags = (*plug).selmon->sel->tags ^ (arg->ui & TAGMASK);
 	if (newtags) {
 		(*plug).selmon->sel->tags = newtags;
+		(*plug).clientgen++;
 		focus(NULL);
 		arrange((*plug).selmon);
 	}
@@ -1915,10 +3939,14 @@ __unmanage(Client *c, int destroyed)
 	Monitor *m = c->mon;
 	XWindowChanges wc;
 
+	wintabdel(c);
+	clientlistdel(c->win);
+	if (c->isminimized)
+		shelfdel(c);
 	detach(c);
 	detachstack(c);
 	if (!destroyed) {
-		wc.border_width = c->oldbw;
+		wc.border_width = COLD(c)->oldbw;
 		XGrabServer((*plug).dpy); /* avoid race conditions */
 		XSetErrorHandler(xerrordummy);
 		XSelectInput((*plug).dpy, c->win, NoEventMask);
@@ -1929,7 +3957,7 @@ __unmanage(Client *c, int destroyed)
 		XSetErrorHandler(xerror);
 		XUngrabServer((*plug).dpy);
 	}
-	free(c);
+	clientfree(c);
 	focus(NULL);
 	updateclientlist();
 	arrange(m);
@@ -1965,6 +3993,7 @@ __updatebars(void)
 		m->barwin = XCreateWindow((*plug).dpy, (*plug).root, m->wx, m->by, m->ww, (*plug).bh, 0, DefaultDepth((*plug).dpy, (*plug).screen),
 					  CopyFromParent, DefaultVisual((*plug).dpy, (*plug).screen),
 					  CWOverrideRedirect|CWBackPixmap|CWEventMask, &wa);
+		m->barbuf = drw_buf_create((*plug).drw, m->ww, (*plug).bh);
 		XDefineCursor((*plug).dpy, m->barwin, (*plug).cursor[CurNormal]->cursor);
 		XMapRaised((*plug).dpy, m->barwin);
 		XSetClassHint((*plug).dpy, m->barwin, &ch);
@@ -1987,27 +4016,32 @@ __updatebarpos(Monitor *m)
 void
 __updateclientlist(void)
 {
-	Client *c;
-	Monitor *m;
-
-	XDeleteProperty((*plug).dpy, (*plug).root, (*plug).netatom[NetClientList]);
-	for (m = (*plug).mons; m; m = m->next)
-		for (c = m->clients; c; c = c->next)
-			XChangeProperty((*plug).dpy, (*plug).root, (*plug).netatom[NetClientList],
-					XA_WINDOW, 32, PropModeAppend,
-					(unsigned char *) &(c->win), 1);
+	/* a batch writes it once at its end, see drawqueued() */
+	if (!(*plug).clientlistdirty || (*plug).batching)
+		return;
+	(*plug).clientlistdirty = 0;
+	XChangeProperty((*plug).dpy, (*plug).root, (*plug).netatom[NetClientList],
+			XA_WINDOW, 32, PropModeReplace,
+			(unsigned char *) (*plug).clientlist, (*plug).nclientlist);
 }
 
 int
 __updategeom(void)
 {
 	int dirty = 0;
+	Monitor *m;
 
+	for (m = (*plug).mons; m; m = m->next)
+		m->geomdirty = 0;
+#ifdef XRANDR
+	if ((*plug).rrbase != -1)
+		dirty = rrgeom();
+	else
+#endif /* XRANDR */
 #ifdef XINERAMA
 	if (XineramaIsActive((*plug).dpy)) {
 		int i, j, n, nn;
 		Client *c;
-		Monitor *m;
 		XineramaScreenInfo *info = XineramaQueryScreens((*plug).dpy, &nn);
 		XineramaScreenInfo *unique = NULL;
 
@@ -2028,19 +4062,11 @@ __updategeom(void)
 			else
 				(*plug).mons = createmon();
 		}
-		for (i = 0, m = (*plug).mons; i < nn && m; m = m->next, i++)
-			if (i >= n
-			    || unique[i].x_org != m->mx || unique[i].y_org != m->my
-			    || unique[i].width != m->mw || unique[i].height != m->mh)
-			{
-				dirty = 1;
-				m->num = i;
-				m->mx = m->wx = unique[i].x_org;
-				m->my = m->wy = unique[i].y_org;
-				m->mw = m->ww = unique[i].width;
-				m->mh = m->wh = unique[i].height;
-				updatebarpos(m);
-			}
+		for (i = 0, m = (*plug).mons; i < nn && m; m = m->next, i++) {
+			m->num = i;
+			dirty |= setgeom(m, unique[i].x_org, unique[i].y_org,
+			                 unique[i].width, unique[i].height);
+		}
 		/* removed monitors if n > nn */
 		for (i = nn; i < n; i++) {
 			for (m = (*plug).mons; m && m->next; m = m->next);
@@ -2048,9 +4074,14 @@ __updategeom(void)
 				dirty = 1;
 				m->clients = c->next;
 				detachstack(c);
+				if (c->isminimized)
+					shelfdel(c);
 				c->mon = (*plug).mons;
 				attach(c);
 				attachstack(c);
+				if (c->isminimized)
+					shelfadd(c);
+				(*plug).mons->geomdirty = 1;
 			}
 			if (m == (*plug).selmon)
 				(*plug).selmon = (*plug).mons;
@@ -2062,12 +4093,7 @@ __updategeom(void)
 	{ /* default monitor setup */
 		if (!(*plug).mons)
 			(*plug).mons = createmon();
-		if ((*plug).mons->mw != (*plug).sw || (*plug).mons->mh != (*plug).sh) {
-			dirty = 1;
-			(*plug).mons->mw = (*plug).mons->ww = (*plug).sw;
-			(*plug).mons->mh = (*plug).mons->wh = (*plug).sh;
-			updatebarpos((*plug).mons);
-		}
+		dirty = setgeom((*plug).mons, 0, 0, (*plug).sw, (*plug).sh);
 	}
 	if (dirty) {
 		(*plug).selmon = (*plug).mons;
@@ -2101,68 +4127,34 @@ __updatesizehints(Client *c)
 	if (!XGetWMNormalHints((*plug).dpy, c->win, &size, &msize))
 		/* size is uninitialized, ensure that size.flags aren't used */
 		size.flags = PSize;
-	if (size.flags & PBaseSize) {
-		c->basew = size.base_width;
-		c->baseh = size.base_height;
-	} else if (size.flags & PMinSize) {
-		c->basew = size.min_width;
-		c->baseh = size.min_height;
-	} else
-		c->basew = c->baseh = 0;
-	if (size.flags & PResizeInc) {
-		c->incw = size.width_inc;
-		c->inch = size.height_inc;
-	} else
-		c->incw = c->inch = 0;
-	if (size.flags & PMaxSize) {
-		c->maxw = size.max_width;
-		c->maxh = size.max_height;
-	} else
-		c->maxw = c->maxh = 0;
-	if (size.flags & PMinSize) {
-		c->minw = size.min_width;
-		c->minh = size.min_height;
-	} else if (size.flags & PBaseSize) {
-		c->minw = size.base_width;
-		c->minh = size.base_height;
-	} else
-		c->minw = c->minh = 0;
-	if (size.flags & PAspect) {
-		c->mina = (float)size.min_aspect.y / size.min_aspect.x;
-		c->maxa = (float)size.max_aspect.x / size.max_aspect.y;
-	} else
-		c->maxa = c->mina = 0.0;
-	c->isfixed = (c->maxw && c->maxh && c->maxw == c->minw && c->maxh == c->minh);
-	c->hintsvalid = 1;
+	setsizehints(c, &size);
 }
 
 void
 __updatestatus(void)
 {
-	if (!gettextprop((*plug).root, XA_WM_NAME, (*plug).stext, sizeof((*plug).stext)))
-		strcpy((*plug).stext, "dwm-"VERSION);
-	drawbar((*plug).selmon);
+	char text[sizeof *(*plug).stext];
+
+	gettextprop((*plug).root, XA_WM_NAME, text, sizeof text); /* empty if unset */
+	setstatus(0, text, strlen(text));
 }
 
 void
 __updatetitle(Client *c)
 {
-	if (!gettextprop(c->win, (*plug).netatom[NetWMName], c->name, sizeof c->name))
-		gettextprop(c->win, XA_WM_NAME, c->name, sizeof c->name);
-	if (c->name[0] == '\0') /* hack to mark broken clients */
-		strcpy(c->name, (*plug).broken);
+	ClientCold *cc = COLD(c);
+
+	if (!gettextprop(c->win, (*plug).netatom[NetWMName], cc->name, sizeof cc->name))
+		gettextprop(c->win, XA_WM_NAME, cc->name, sizeof cc->name);
+	if (cc->name[0] == '\0') /* hack to mark broken clients */
+		strcpy(cc->name, (*plug).broken);
 }
 
 void
 __updatewindowtype(Client *c)
 {
-	Atom state = getatomprop(c, (*plug).netatom[NetWMState]);
-	Atom wtype = getatomprop(c, (*plug).netatom[NetWMWindowType]);
-
-	if (state == (*plug).netatom[NetWMFullscreen])
-		setfullscreen(c, 1);
-	if (wtype == (*plug).netatom[NetWMWindowTypeDialog])
-		c->isfloating = 1;
+	setwindowtype(c, getatomprop(c, (*plug).netatom[NetWMState]),
+	              getatomprop(c, (*plug).netatom[NetWMWindowType]));
 }
 
 void
@@ -2171,15 +4163,7 @@ __updatewmhints(Client *c)
 	XWMHints *wmh;
 
 	if ((wmh = XGetWMHints((*plug).dpy, c->win))) {
-		if (c == (*plug).selmon->sel && wmh->flags & XUrgencyHint) {
-			wmh->flags &= ~XUrgencyHint;
-			XSetWMHints((*plug).dpy, c->win, wmh);
-		} else
-			c->isurgent = (wmh->flags & XUrgencyHint) ? 1 : 0;
-		if (wmh->flags & InputHint)
-			c->neverfocus = !wmh->input;
-		else
-			c->neverfocus = 0;
+		setwmhints(c, wmh);
 		XFree(wmh);
 	}
 }
@@ -2199,13 +4183,14 @@ __view(const Arg *arg)
 Client *
 __wintoclient(Window w)
 {
+	unsigned int i, mask = (*plug).wintabcap - 1;
 	Client *c;
-	Monitor *m;
 
-	for (m = (*plug).mons; m; m = m->next)
-		for (c = m->clients; c; c = c->next)
-			if (c->win == w)
-				return c;
+	if (!(*plug).wintabcap)
+		return NULL;
+	for (i = winhash(w) & mask; (c = (*plug).wintab[i]); i = (i + 1) & mask)
+		if (c->win == w)
+			return c;
 	return NULL;
 }
 
@@ -2274,218 +4259,514 @@ __zoom(const Arg *arg)
 	pop(c);
 }
 
-void __minimize(Client *c) {
-	if (!c || c->isminimized) return;
-
-	c->maximx = c->x;
-	c->maximy = c->y;
-	c->maximw = c->w;
-	c->maximh = c->h;
+/* Minimized clients are hidden like those of other tags, and their
+ * monitor's shelf shows them on the bar. Only if c is tiled does the layout
+ * rerun, a floating one is just moved out of sight. */
+void
+__minimize(Client *c)
+{
+	Monitor *m;
+	int vis;
 
-	Client *d = c->mon->clients;
-	int x = c->mon->mx;
+	if (!c || c->isminimized)
+		return;
+	if (c->isfullscreen)
+		setfullscreen(c, 0);
+	m = c->mon;
+	vis = ISVISIBLE(c);
 	c->isminimized = 1;
-	c->isfloating = 1;
-	c->isfullscreen = 0;
-	while (d) {
-		if (d->isminimized && d->mon == c->mon) {
-			resize(d, x, d->mon->my + (*plug).drw->fonts->h + 2, 50, 20, 0);
-			x += 50;
+	shelfadd(c);
+	if (vis && m->lt[m->sellt]->arrange && !c->isfloating) {
+		(*plug).clientgen++;
+		arrange(m);
+	} else if (vis)
+		XMoveWindow((*plug).dpy, c->win, WIDTH(c) * -2, c->y);
+	if (c == m->sel)
+		focus(NULL);
+	else
+		drawbar(m);
+}
+
+void
+__restore(Client *c)
+{
+	Monitor *m;
+
+	if (!c || !c->isminimized)
+		return;
+	m = c->mon;
+	shelfdel(c);
+	c->isminimized = 0;
+	if (!ISVISIBLE(c)) {
+		drawbar(m); /* shown once its tags are viewed */
+		return;
+	}
+	if (m->lt[m->sellt]->arrange && !c->isfloating) {
+		(*plug).clientgen++;
+		arrange(m);
+	} else
+		XMoveWindow((*plug).dpy, c->win, c->x, c->y);
+	focus(c);
+	restack(m);
+}
+
+/* minimize the selected client, or restore the one minimized last */
+void
+__toggleminimize(const Arg *arg)
+{
+	Arg a;
+
+	if ((*plug).selmon->sel)
+		minimize((*plug).selmon->sel);
+	else if ((*plug).selmon->nshelf) {
+		a.ui = (*plug).selmon->nshelf - 1;
+		unshelve(&a);
+	}
+}
+
+/* restore the client in slot arg->ui of the shelf, viewing its tags first */
+void
+__unshelve(const Arg *arg)
+{
+	Monitor *m = (*plug).selmon;
+	Client *c;
+	Arg a;
+
+	if (arg->ui >= m->nshelf)
+		return;
+	c = m->shelf[arg->ui];
+	if (!(c->tags & m->tagset[m->seltags])) {
+		a.ui = c->tags;
+		view(&a);
+	}
+	restore(c);
+}
+
+/* Write the layout of all clients and monitors into a memfd that is
+ * inherited across exec. Returns the descriptor or -1. */
+static int
+snapwrite(void)
+{
+	SnapHeader *h;
+	SnapMon *sm;
+	SnapClient *sc;
+	uint32_t *stack;
+	Monitor *m;
+	Client *c;
+	size_t size;
+	unsigned int nm = 0, nc = 0, i;
+	char *buf;
+	int fd;
+
+	for (m = (*plug).mons; m; m = m->next, nm++)
+		for (c = m->clients; c; c = c->next, nc++);
+	size = sizeof *h + nm * sizeof *sm + nc * (sizeof *sc + sizeof *stack);
+	buf = ecalloc(1, size);
+	h = (SnapHeader *)buf;
+	sm = (SnapMon *)(h + 1);
+	sc = (SnapClient *)(sm + nm);
+	stack = (uint32_t *)(sc + nc);
+	*h = (SnapHeader){ SNAPMAGIC, SNAPVERSION, nm, nc, 0 };
+	for (m = (*plug).mons, i = 0; m; m = m->next, i++, sm++) {
+		if (m == (*plug).selmon)
+			h->selmon = i;
+		*sm = (SnapMon){ m->mfact, m->nmaster, { m->tagset[0], m->tagset[1] },
+			m->seltags, m->sellt, { m->lt[0] - layouts, m->lt[1] - layouts }, m->showbar };
+		for (c = m->clients; c; c = c->next)
+			*sc++ = (SnapClient){ c->win, i, c->tags, c->x, c->y, c->w, c->h,
+				c->isfloating, c->isminimized };
+		for (c = m->stack; c; c = c->snext)
+			*stack++ = c->win;
+	}
+	if ((fd = memfd_create("dwm-snapshot", 0)) != -1 && write(fd, buf, size) != (ssize_t)size) {
+		close(fd);
+		fd = -1;
+	}
+	free(buf);
+	return fd;
+}
+
+/* slot of w in the open-addressed set of cap windows, or the free one
+ * it goes to */
+static unsigned int
+winslot(const Window *set, unsigned int cap, Window w)
+{
+	unsigned int i;
+
+	for (i = winhash(w) & (cap - 1); set[i] && set[i] != w; i = (i + 1) & (cap - 1));
+	return i;
+}
+
+/* Put the clients scan() managed back the way snapwrite() left them. */
+static void
+snapread(int fd)
+{
+	const SnapHeader *h;
+	const SnapMon *sm;
+	const SnapClient *sc;
+	const uint32_t *stack;
+	struct stat st;
+	Monitor **mons, *m;
+	Client *c, **rest;
+	Window *set, w;
+	unsigned char *state; /* of set: 1 once in a client list, 2 in a stack */
+	unsigned int i, j, n, nm, nr, cap;
+	void *p;
+
+	if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof *h
+	    || (p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+		close(fd);
+		return;
+	}
+	close(fd);
+	h = p;
+	sm = (const SnapMon *)(h + 1);
+	sc = (const SnapClient *)(sm + h->nmons);
+	stack = (const uint32_t *)(sc + h->nclients);
+	if (h->magic != SNAPMAGIC || h->version != SNAPVERSION
+	    || (size_t)st.st_size != sizeof *h + h->nmons * sizeof *sm
+	    + h->nclients * (sizeof *sc + sizeof *stack)) {
+		munmap(p, st.st_size);
+		return;
+	}
+
+	/* snapshot monitors that are gone now map to the first one */
+	for (nm = 0, m = (*plug).mons; m; m = m->next, nm++);
+	mons = ecalloc(MAX(h->nmons, 1), sizeof *mons);
+	for (i = 0, m = (*plug).mons; i < h->nmons; i++) {
+		mons[i] = m ? m : (*plug).mons;
+		if (m)
+			m = m->next;
+	}
+	for (i = 0; i < h->nmons && i < nm; i++, sm++) {
+		m = mons[i];
+		m->mfact = sm->mfact;
+		m->nmaster = sm->nmaster;
+		m->tagset[0] = sm->tagset[0] & TAGMASK ? sm->tagset[0] & TAGMASK : 1;
+		m->tagset[1] = sm->tagset[1] & TAGMASK ? sm->tagset[1] & TAGMASK : 1;
+		m->seltags = sm->seltags & 1;
+		m->sellt = sm->sellt & 1;
+		for (j = 0; j < 2; j++)
+			m->lt[j] = &layouts[sm->lt[j] < LENGTH(layouts) ? sm->lt[j] : 0];
+		if (m->showbar != (int)sm->showbar) {
+			m->showbar = sm->showbar;
+			updatebarpos(m);
+			XMoveResizeWindow((*plug).dpy, m->barwin, m->wx, m->by, m->ww, (*plug).bh);
 		}
-		d = d->next;
 	}
-	c->isfixed = 1;
-	arrange(c->mon);
+
+	/* the windows of the snapshot, to tell its clients from new ones */
+	for (cap = 2; cap < 2 * h->nclients; cap <<= 1);
+	set = ecalloc(cap, sizeof *set);
+	state = ecalloc(cap, 1);
+	for (i = 0; i < h->nclients; i++)
+		set[winslot(set, cap, sc[i].win)] = sc[i].win;
+
+	/* rebuild every list: snapshot order first, then the rest as is */
+	for (n = 0, m = (*plug).mons; m; m = m->next)
+		for (c = m->clients; c; c = c->next, n++);
+	rest = ecalloc(n + 1, sizeof *rest);
+	for (nr = 0, m = (*plug).mons; m; m = m->next)
+		for (c = m->clients; c; c = c->next)
+			if (!set[winslot(set, cap, c->win)])
+				rest[nr++] = c;
+	for (m = (*plug).mons; m; m = m->next)
+		m->clients = m->stack = NULL;
+	for (i = nr; i--; ) {
+		attach(rest[i]);
+		attachstack(rest[i]);
+	}
+	for (i = h->nclients; i--; ) {
+		j = winslot(set, cap, sc[i].win);
+		if (state[j] || !(c = wintoclient(sc[i].win)))
+			continue; /* listed twice or gone */
+		state[j] = 1;
+		c->mon = mons[sc[i].mon < h->nmons ? sc[i].mon : 0];
+		if (sc[i].tags & TAGMASK)
+			c->tags = sc[i].tags & TAGMASK;
+		c->isfloating = sc[i].isfloating || c->isfixed;
+		attach(c);
+		if ((c->isminimized = sc[i].isminimized))
+			shelfadd(c);
+		if (c->isfloating && !c->isfullscreen)
+			resize(c, sc[i].x, sc[i].y, sc[i].w, sc[i].h, 0);
+	}
+	for (i = h->nclients; i--; ) {
+		j = winslot(set, cap, w = stack[i]);
+		if (set[j] == w && state[j] == 1 && (c = wintoclient(w))) {
+			state[j] = 2;
+			attachstack(c);
+		}
+	}
+	for (i = 0; i < h->nclients; i++) /* missing from the stack order */
+		if (state[j = winslot(set, cap, sc[i].win)] == 1) {
+			state[j] = 2;
+			attachstack(wintoclient(sc[i].win));
+		}
+	if (h->selmon < h->nmons)
+		(*plug).selmon = mons[h->selmon];
+	free(rest);
+	free(state);
+	free(set);
+	free(mons);
+	munmap(p, st.st_size);
+	focus(NULL);
+	arrange(NULL);
 }
-void __restore(Client *c) {
-	if (!c || !c->isminimized) return;
-    
-	resize(c, c->maximx, c->maximy, c->maximw, c->maximh, 1);
 
-	Client *d = c->mon->clients;
-	int x = c->mon->mx;
-	c->isminimized = 0;
-	c->isfixed = 0;
-	while (d) {
-		if (d->isminimized && d->mon == c->mon) {
-			resize(d, x, d->mon->my + (*plug).drw->fonts->h + 2, 50, 10, 0);
-			x += 50;
+/* exec path with the layout in a snapshot, returns if it cannot */
+static void
+execrestart(const char *path)
+{
+	char num[16];
+	int fd;
+
+	if (access(path, X_OK) == -1) {
+		showmsg("cannot restart dwm", 5000);
+		return;
+	}
+	if ((fd = snapwrite()) != -1) {
+		snprintf(num, sizeof num, "%d", fd);
+		setenv("DWM_SNAPSHOT", num, 1);
+	}
+	XCloseDisplay((*plug).dpy); /* the new instance selects on root */
+	execl(path, "dwm", (char *)NULL);
+	die("dwm: execl '%s' failed:", path);
+}
+
+void
+__restart(const Arg *arg)
+{
+	execrestart("/proc/self/exe");
+}
+
+/* the reloadable function pointers, in the same order in every build */
+static void *slots[] = {
+	&applyrules, &addtimer, &applysizehints, &arrange, &arrangemon,
+	&attach, &attachstack, &buttonpress, &builddone, &checkotherwm,
+	&cleanup, &cleanupmon, &clearmsg, &clientmessage, &clocktick,
+	&compilerules, &configure, &configurenotify, &configurerequest,
+	&createmon, &deltimer, &destroynotify, &detach, &detachstack,
+	&dirtomon, &drawbar, &drawbars, &enternotify, &expose, &focus,
+	&focusin, &focusmon, &focusstack, &gathertiled, &getatomprop,
+	&getrootptr, &getstate, &gettextprop, &grabbuttons, &grabkeys,
+	&incnmaster, &keypress, &killclient, &manage, &mappingnotify,
+	&maprequest, &monocle, &motionnotify, &movemouse, &nexttiled,
+	&placeclients, &placehints, &pop, &propertynotify, &quit, &readctl,
+	&readsock, &recttomon, &resize, &resizeclient, &resizemouse,
+	&restack, &restart, &run, &runtimers, &scan, &sendevent, &sendmon,
+	&setclientstate, &setfocus, &setfullscreen, &setlayout, &setmfact,
+	&settimer, &setup, &seturgent, &showhide, &spawn, &tag, &tagmon,
+	&tile, &togglebar, &togglefloating, &toggletag, &toggleview,
+	&unfocus, &unmanage, &unmapnotify, &updatebarpos, &updatebars,
+	&updateclientlist, &updategeom, &updatenumlockmask, &updatesizehints,
+	&updatestatus, &updatetitle, &updatewindowtype, &updatewmhints,
+	&view, &wintoclient, &wintomon, &xerror, &xerrordummy, &xerrorstart,
+	&zoom, &minimize, &restore, &toggleminimize, &unshelve, &reloads,
+};
+
+const Symtab symtab = {
+	.abi = PLUGABI,
+	.plugsize = sizeof(Plug),
+	.monitorsize = sizeof(Monitor),
+	.clientsize = sizeof(Client),
+	.coldsize = sizeof(ClientCold),
+	.plug = &plug,
+	.applysymlinks = applysymlinks,
+	.layouts = layouts,
+	.nlayouts = LENGTH(layouts),
+	.slots = slots,
+	.nslots = LENGTH(slots),
+};
+
+/* point the function pointers of this build at those t had bound */
+static void
+bindsyms(const Symtab *t)
+{
+	unsigned int i;
+
+	for (i = 0; i < LENGTH(slots); i++)
+		memcpy(slots[i], t->slots[i], sizeof(void (*)(void)));
+}
+
+/* Start make for dwm and dwm.so in plugdir, logging to reloads.log there. SIGCHLD
+ * is ignored, so a child waits for make and reports success as one byte
+ * on the returned pipe, which run() polls. */
+static int
+buildplug(void)
+{
+	int fd[2], log, status;
+	char ok;
+	pid_t pid;
+
+	if (pipe2(fd, O_CLOEXEC) == -1)
+		return -1;
+	if ((pid = fork()) == -1) {
+		close(fd[0]);
+		close(fd[1]);
+		return -1;
+	}
+	if (!pid) {
+		close(fd[0]);
+		signal(SIGCHLD, SIG_DFL);
+		ok = 0;
+		if (chdir(plugdir) != -1 && (pid = fork()) != -1) {
+			if (!pid) {
+				if ((log = open("reloads.log", O_WRONLY|O_CREAT|O_TRUNC, 0644)) != -1) {
+					dup2(log, STDOUT_FILENO);
+					dup2(log, STDERR_FILENO);
+				}
+				execlp("make", "make", (char *)NULL);
+				_exit(127);
+			}
+			ok = waitpid(pid, &status, 0) == pid && WIFEXITED(status) && !WEXITSTATUS(status);
 		}
-		d = d->next;
+		if (write(fd[1], &ok, 1) == -1)
+			_exit(1);
+		_exit(0);
 	}
-	arrange(c->mon);
+	close(fd[1]);
+	return fd[0];
+}
+
+/* dlopen a private copy of path, as the loader hands out the handle it
+ * already has for a path loaded before and make overwrites dwm.so in
+ * place. The copy is unlinked right away, its mapping stays. */
+static void *
+openplug(const char *path)
+{
+	char tmp[] = "/tmp/dwm-XXXXXX", buf[BUFSIZ];
+	int in, out;
+	ssize_t n = -1;
+	void *dl = NULL;
+
+	if ((in = open(path, O_RDONLY|O_CLOEXEC)) == -1)
+		return NULL;
+	if ((out = mkstemp(tmp)) != -1) {
+		while ((n = read(in, buf, sizeof buf)) > 0)
+			if (write(out, buf, n) != n) {
+				n = -1;
+				break;
+			}
+		close(out);
+		if (!n)
+			dl = dlopen(tmp, RTLD_NOW | RTLD_LOCAL);
+		unlink(tmp);
+	}
+	close(in);
+	return dl;
+}
+
+/* Load the freshly built dwm.so and bind it in place of this build,
+ * leaving everything untouched if it cannot be used. */
+static void
+swapplug(void)
+{
+	char path[PATH_MAX];
+	const Symtab *t, *old = (*plug).symtab;
+	Monitor *m;
+	void *dl;
+	int i, j;
+
+	snprintf(path, sizeof path, "%s/dwm.so", plugdir);
+	if (!(dl = openplug(path))) {
+		fprintf(stderr, "dwm: cannot load %s: %s\n", path, dlerror());
+		showmsg("cannot load dwm.so", 5000);
+		return;
+	}
+	if (!(t = dlsym(dl, "symtab")) || t->abi != PLUGABI || t->plugsize != sizeof(Plug)
+	    || t->monitorsize != sizeof(Monitor) || t->clientsize != sizeof(Client)
+	    || t->coldsize != sizeof(ClientCold)
+	    || t->nslots != LENGTH(slots) || !t->nlayouts) {
+		/* a new layout of the state takes the new binary, keeping
+		 * the clients where they are through a snapshot */
+		dlclose(dl);
+		snprintf(path, sizeof path, "%s/dwm", plugdir);
+		execrestart(path);
+		return;
+	}
+	if ((*plug).msgtimer != -1) {
+		deltimer((*plug).msgtimer);
+		clearmsg();
+	}
+	*t->plug = plug;
+	t->applysymlinks();
+
+	/* nothing may keep pointing into the old build once it is unloaded */
+	for (i = 0; i < (*plug).ntimers; i++)
+		for (j = 0; j < LENGTH(slots); j++)
+			if ((void *)(*plug).timers[i].func == old->slots[j])
+				(*plug).timers[i].func = t->slots[j];
+	for (m = (*plug).mons; m; m = m->next)
+		for (i = 0; i < 2; i++) {
+			j = m->lt[i] - old->layouts;
+			m->lt[i] = &t->layouts[j >= 0 && (unsigned int)j < t->nlayouts ? j : 0];
+		}
+	(*plug).bind(t);
+	(*plug).symtab = t;
+	for (i = 0; slots[i] != &xerror; i++);
+	XSetErrorHandler(*(int (**)(Display *, XErrorEvent *))t->slots[i]);
+	for (i = 0; slots[i] != &grabkeys; i++);
+	(*(void (**)(void))t->slots[i])(); /* the keytab indexes its keys[] */
+	for (i = 0; slots[i] != &compilerules; i++);
+	(*(void (**)(void))t->slots[i])();
+
+	/* run() returns into main(), which unloads the previous build */
+	if ((*plug).dl)
+		(*plug).olddl = (*plug).dl;
+	(*plug).dl = dl;
+	(*plug).reloaded = 1;
+	(*plug).running = 0;
 }
-void __toggleminimize(const Arg* arg) {
-	if ((*plug).selmon->sel->isminimized)
-		restore((*plug).selmon->sel);
+
+void
+__builddone(void)
+{
+	char ok = 0;
+
+	if (read((*plug).buildfd, &ok, 1) == -1 && errno == EINTR)
+		return; /* poll() reports it again */
+	close((*plug).buildfd);
+	(*plug).buildfd = -1;
+	if (ok)
+		swapplug();
 	else
-		minimize((*plug).selmon->sel);
+		showmsg("building dwm.so failed, see reloads.log", 5000);
+}
+
+void
+__reloads(const Arg *arg)
+{
+	if ((*plug).buildfd != -1)
+		return; /* the build under way is swapped in once it is done */
+	if (((*plug).buildfd = buildplug()) == -1)
+		showmsg("cannot run make for dwm.so", 5000);
+	else
+		showmsg("building dwm.so", 60000);
 }
 
-void __reloads(const Arg *arg) {
-	printf("Loading...\n");
-	system("cd /home/sony/dwm/ && make -B &> /home/sony/dwm/reloads.log");
-	printf("Loading...\n");
-	char tmp[512];
-	printf("Loading...\n");
-	snprintf(tmp, 512, "/tmp/dwm-%d.so", rand());
-	printf("Loading...\n");
-	system("rm /tmp/dwm*.so");
-	printf("Loading...\n");
-	pid_t pid = fork();
-	int status;
-	if (!pid)
-		execve("/usr/bin/cp", (char *[]){"cp", "/home/sony/dwm/dwm.so", tmp, NULL}, __environ);
-	else waitpid(pid, &status, 0);
-	printf("Loading...\n");
-	if ((*plug).dl) {
-		printf("Old: %p\n", plug->dl);
-		// dlclose((*plug).dl);
-		plug->dl = NULL;
-	}
-	printf("%s\n", tmp);
-	void *handle = dlopen(tmp, RTLD_NOW || RTLD_LOCAL);
-	printf("New: %p\n", handle);
-	// abort();
-	if (!handle) return;
-
-	(*plug).dl = handle;
-
-	memcpy(dlsym((*plug).dl, "plug"), &plug, sizeof(Plug *));
-
-	((void(*)())dlsym((*plug).dl, "applysymlinks"))();
-	
-	applyrules				= dlsym((*plug).dl, "__applyrules");
-	applysizehints				= dlsym((*plug).dl, "__applysizehints");
-	arrange					= dlsym((*plug).dl, "__arrange");
-	arrangemon				= dlsym((*plug).dl, "__arrangemon");
-	attach					= dlsym((*plug).dl, "__attach");
-	attachstack				= dlsym((*plug).dl, "__attachstack");
-	buttonpress				= dlsym((*plug).dl, "__buttonpress");
-	checkotherwm				= dlsym((*plug).dl, "__checkotherwm");
-	cleanup					= dlsym((*plug).dl, "__cleanup");
-	cleanupmon				= dlsym((*plug).dl, "__cleanupmon");
-	clientmessage				= dlsym((*plug).dl, "__clientmessage");
-	configure				= dlsym((*plug).dl, "__configure");
-	configurenotify				= dlsym((*plug).dl, "__configurenotify");
-	configurerequest			= dlsym((*plug).dl, "__configurerequest");
-	createmon				= dlsym((*plug).dl, "__createmon");
-	destroynotify				= dlsym((*plug).dl, "__destroynotify");
-	detach					= dlsym((*plug).dl, "__detach");
-	detachstack				= dlsym((*plug).dl, "__detachstack");
-	dirtomon				= dlsym((*plug).dl, "__dirtomon");
-	drawbar					= dlsym((*plug).dl, "__drawbar");
-	drawbars				= dlsym((*plug).dl, "__drawbars");
-	enternotify				= dlsym((*plug).dl, "__enternotify");
-	expose					= dlsym((*plug).dl, "__expose");
-	focus					= dlsym((*plug).dl, "__focus");
-	focusin					= dlsym((*plug).dl, "__focusin");
-	focusmon				= dlsym((*plug).dl, "__focusmon");
-	focusstack				= dlsym((*plug).dl, "__focusstack");
-	getatomprop				= dlsym((*plug).dl, "__getatomprop");
-	getrootptr				= dlsym((*plug).dl, "__getrootptr");
-	getstate				= dlsym((*plug).dl, "__getstate");
-	gettextprop				= dlsym((*plug).dl, "__gettextprop");
-	grabbuttons				= dlsym((*plug).dl, "__grabbuttons");
-	grabkeys				= dlsym((*plug).dl, "__grabkeys");
-	incnmaster				= dlsym((*plug).dl, "__incnmaster");
-	keypress				= dlsym((*plug).dl, "__keypress");
-	killclient				= dlsym((*plug).dl, "__killclient");
-	manage					= dlsym((*plug).dl, "__manage");
-	mappingnotify				= dlsym((*plug).dl, "__mappingnotify");
-	maprequest				= dlsym((*plug).dl, "__maprequest");
-	monocle					= dlsym((*plug).dl, "__monocle");
-	motionnotify				= dlsym((*plug).dl, "__motionnotify");
-	movemouse				= dlsym((*plug).dl, "__movemouse");
-	nexttiled				= dlsym((*plug).dl, "__nexttiled");
-	pop					= dlsym((*plug).dl, "__pop");
-	propertynotify				= dlsym((*plug).dl, "__propertynotify");
-	recttomon				= dlsym((*plug).dl, "__recttomon");
-	resize					= dlsym((*plug).dl, "__resize");
-	resizeclient				= dlsym((*plug).dl, "__resizeclient");
-	resizemouse				= dlsym((*plug).dl, "__resizemouse");
-	restack					= dlsym((*plug).dl, "__restack");
-	run					= dlsym((*plug).dl, "__run");
-	scan					= dlsym((*plug).dl, "__scan");
-	sendevent				= dlsym((*plug).dl, "__sendevent");
-	sendmon					= dlsym((*plug).dl, "__sendmon");
-	setclientstate				= dlsym((*plug).dl, "__setclientstate");
-	setfocus				= dlsym((*plug).dl, "__setfocus");
-	setfullscreen				= dlsym((*plug).dl, "__setfullscreen");
-	setlayout				= dlsym((*plug).dl, "__setlayout");
-	setmfact				= dlsym((*plug).dl, "__setmfact");
-	setup					= dlsym((*plug).dl, "__setup");
-	seturgent				= dlsym((*plug).dl, "__seturgent");
-	showhide				= dlsym((*plug).dl, "__showhide");
-	spawn					= dlsym((*plug).dl, "__spawn");
-	tag					= dlsym((*plug).dl, "__tag");
-	tagmon					= dlsym((*plug).dl, "__tagmon");
-	tile					= dlsym((*plug).dl, "__tile");
-	togglebar				= dlsym((*plug).dl, "__togglebar");
-	togglefloating				= dlsym((*plug).dl, "__togglefloating");
-	toggletag				= dlsym((*plug).dl, "__toggletag");
-	toggleview				= dlsym((*plug).dl, "__toggleview");
-	unfocus					= dlsym((*plug).dl, "__unfocus");
-	unmanage				= dlsym((*plug).dl, "__unmanage");
-	unmapnotify				= dlsym((*plug).dl, "__unmapnotify");
-	updatebarpos				= dlsym((*plug).dl, "__updatebarpos");
-	updatebars				= dlsym((*plug).dl, "__updatebars");
-	updateclientlist			= dlsym((*plug).dl, "__updateclientlist");
-	updategeom				= dlsym((*plug).dl, "__updategeom");
-	updatenumlockmask			= dlsym((*plug).dl, "__updatenumlockmask");
-	updatesizehints				= dlsym((*plug).dl, "__updatesizehints");
-	updatestatus				= dlsym((*plug).dl, "__updatestatus");
-	updatetitle				= dlsym((*plug).dl, "__updatetitle");
-	updatewindowtype			= dlsym((*plug).dl, "__updatewindowtype");
-	updatewmhints				= dlsym((*plug).dl, "__updatewmhints");
-	view					= dlsym((*plug).dl, "__view");
-	wintoclient				= dlsym((*plug).dl, "__wintoclient");
-	wintomon				= dlsym((*plug).dl, "__wintomon");
-	xerror					= dlsym((*plug).dl, "__xerror");
-	xerrordummy				= dlsym((*plug).dl, "__xerrordummy");
-	xerrorstart				= dlsym((*plug).dl, "__xerrorstart");
-	zoom					= dlsym((*plug).dl, "__zoom");
-	minimize				= dlsym((*plug).dl, "__minimize");
-	restore					= dlsym((*plug).dl, "__restore");
-	toggleminimize				= dlsym((*plug).dl, "__toggleminimize");
-	reloads					= dlsym((*plug).dl, "__reloads");
-	minimize				= dlsym((*plug).dl, "__minimize");
-	restore					= dlsym((*plug).dl, "__restore");
-	toggleminimize				= dlsym((*plug).dl, "__toggleminimize");
-	reloads					= dlsym((*plug).dl, "__reloads");
-	(*plug).handler[ButtonPress]		= buttonpress;
-	(*plug).handler[ClientMessage]		= clientmessage;
-	(*plug).handler[ConfigureNotify]	= configurenotify;
-	(*plug).handler[ConfigureRequest]	= configurerequest;
-	(*plug).handler[DestroyNotify]		= destroynotify;
-	(*plug).handler[EnterNotify]		= enternotify;
-	(*plug).handler[Expose]			= expose;
-	(*plug).handler[FocusIn]		= focusin;
-	(*plug).handler[KeyPress]		= keypress;
-	(*plug).handler[MappingNotify]		= mappingnotify;
-	(*plug).handler[MapRequest]		= maprequest;
-	(*plug).handler[MotionNotify]		= motionnotify;
-	(*plug).handler[PropertyNotify]		= propertynotify;
-	(*plug).handler[UnmapNotify]		= unmapnotify;
-        (*plug).running				= 0;
-}
-
-void applysymlinks() {
+void applysymlinks(void) {
 	applyrules		= __applyrules;
+	addtimer		= __addtimer;
 	applysizehints		= __applysizehints;
 	arrange			= __arrange;
 	arrangemon		= __arrangemon;
 	attach			= __attach;
 	attachstack		= __attachstack;
 	buttonpress		= __buttonpress;
+	builddone		= __builddone;
 	checkotherwm		= __checkotherwm;
 	cleanup			= __cleanup;
 	cleanupmon		= __cleanupmon;
+	clearmsg		= __clearmsg;
 	clientmessage		= __clientmessage;
+	clocktick		= __clocktick;
+	compilerules		= __compilerules;
 	configure		= __configure;
 	configurenotify		= __configurenotify;
 	configurerequest	= __configurerequest;
 	createmon		= __createmon;
+	deltimer		= __deltimer;
 	destroynotify		= __destroynotify;
 	detach			= __detach;
 	detachstack		= __detachstack;
@@ -2498,6 +4779,7 @@ void applysymlinks() {
 	focusin			= __focusin;
 	focusmon		= __focusmon;
 	focusstack		= __focusstack;
+	gathertiled		= __gathertiled;
 	getatomprop		= __getatomprop;
 	getrootptr		= __getrootptr;
 	getstate		= __getstate;
@@ -2514,14 +4796,21 @@ void applysymlinks() {
 	motionnotify		= __motionnotify;
 	movemouse		= __movemouse;
 	nexttiled		= __nexttiled;
+	placeclients		= __placeclients;
+	placehints		= __placehints;
 	pop			= __pop;
 	propertynotify		= __propertynotify;
+	quit			= __quit;
+	readctl			= __readctl;
+	readsock		= __readsock;
 	recttomon		= __recttomon;
 	resize			= __resize;
 	resizeclient		= __resizeclient;
 	resizemouse		= __resizemouse;
 	restack			= __restack;
+	restart			= __restart;
 	run			= __run;
+	runtimers		= __runtimers;
 	scan			= __scan;
 	sendevent		= __sendevent;
 	sendmon			= __sendmon;
@@ -2530,6 +4819,7 @@ void applysymlinks() {
 	setfullscreen		= __setfullscreen;
 	setlayout		= __setlayout;
 	setmfact		= __setmfact;
+	settimer		= __settimer;
 	setup			= __setup;
 	seturgent		= __seturgent;
 	showhide		= __showhide;
@@ -2564,6 +4854,7 @@ void applysymlinks() {
 	minimize		= __minimize;
 	restore			= __restore;
 	toggleminimize		= __toggleminimize;
+	unshelve		= __unshelve;
 	reloads			= __reloads;
 	(*plug).handler[ButtonPress] = buttonpress;
 	(*plug).handler[ClientMessage] = clientmessage;
@@ -2579,20 +4870,34 @@ void applysymlinks() {
 	(*plug).handler[MotionNotify] = motionnotify;
 	(*plug).handler[PropertyNotify] = propertynotify;
 	(*plug).handler[UnmapNotify] = unmapnotify;
+#ifdef TRACE
+	/* time these through the same pointers everything calls */
+	arrange			= trarrange;
+	drawbar			= trdrawbar;
+	restack			= trrestack;
+#endif
 }
 
 int
 main(int argc, char *argv[])
 {
+	const char *snap;
+
 	plug = malloc(sizeof(Plug));
 	*plug = (Plug) {
 		.broken = "broken",
 		.numlockmask = 0,
 		.running = 1,
 		.dl = NULL,
+		.buildfd = -1,
+		.sockfd = -1,
+		.rrbase = -1,
+		.msgtimer = -1,
+		.symtab = &symtab,
+		.bind = bindsyms,
 	};
 	applysymlinks();
-    
+
 	if (argc == 2 && !strcmp("-v", argv[1]))
 		die("dwm-"VERSION);
 	else if (argc != 1)
@@ -2604,16 +4909,24 @@ main(int argc, char *argv[])
 	checkotherwm();
 	setup();
 #ifdef __OpenBSD__
-	if (pledge("stdio rpath proc exec", NULL) == -1)
+	if (pledge("stdio rpath cpath proc exec", NULL) == -1)
 		die("pledge");
 #endif /* __OpenBSD__ */
 	scan();
+	if ((snap = getenv("DWM_SNAPSHOT"))) {
+		snapread(atoi(snap));
+		unsetenv("DWM_SNAPSHOT");
+	}
 	do {
 		(*plug).running = 1;
+		(*plug).reloaded = 0;
 		run();
-		printf("run() Ends\n");
-	}
-	while (plug->dl);
+		/* reloads() swapped builds, no code of the old one runs anymore */
+		if ((*plug).olddl) {
+			dlclose((*plug).olddl);
+			(*plug).olddl = NULL;
+		}
+	} while ((*plug).reloaded);
 	cleanup();
 	XCloseDisplay((*plug).dpy);
 	return EXIT_SUCCESS;
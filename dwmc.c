@@ -0,0 +1,65 @@
+/* cc dwmc.c -o dwmc, sends dwm one control message, see dwm(1) */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static const struct {
+	const char *name;
+	char op;
+	int args;             /* the segment of status counts as one */
+} cmds[] = {
+	{ "status", 's', 2 },
+	{ "view",   'v', 1 },
+	{ "tag",    'g', 1 },
+	{ "layout", 'l', 1 },
+	{ "reload", 'r', 0 },
+	{ "quit",   'q', 0 },
+	{ "trace",  't', 0 },
+};
+
+static void
+usage(void)
+{
+	fputs("usage: dwmc status segment text | view tagmask | tag tagmask\n"
+	      "            | layout index | reload | quit | trace\n", stderr);
+	exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct sockaddr_un sa = { .sun_family = AF_UNIX };
+	const char *dir = getenv("XDG_RUNTIME_DIR"), *dpy = getenv("DISPLAY");
+	char msg[256];
+	size_t i;
+	int fd, n;
+
+	if (argc < 2)
+		usage();
+	for (i = 0; i < sizeof cmds / sizeof *cmds && strcmp(argv[1], cmds[i].name); i++);
+	if (i == sizeof cmds / sizeof *cmds || argc - 2 != cmds[i].args)
+		usage();
+	if (cmds[i].args == 2) /* the segment as one digit, then the text */
+		n = snprintf(msg, sizeof msg, "%c%.1s%s", cmds[i].op, argv[2], argv[3]);
+	else
+		n = snprintf(msg, sizeof msg, "%c%s", cmds[i].op, cmds[i].args ? argv[2] : "");
+	if (n >= (int)sizeof msg)
+		n = sizeof msg - 1;
+
+	if (!dpy) {
+		fputs("dwmc: DISPLAY is not set\n", stderr);
+		return 1;
+	}
+	snprintf(sa.sun_path, sizeof sa.sun_path, "%s/dwm-%s.sock", dir ? dir : "/tmp", dpy);
+	if ((fd = socket(AF_UNIX, SOCK_DGRAM, 0)) == -1
+	    || sendto(fd, msg, n, 0, (struct sockaddr *)&sa, sizeof sa) == -1) {
+		perror(sa.sun_path);
+		return 1;
+	}
+	close(fd);
+	return 0;
+}
@@ -1,17 +1,48 @@
 #pragma once
 
 #include <X11/Xlib.h>
+
+/* reloads() compares the sizes of Plug, Monitor, Client and ClientCold;
+ * bump this for a change of their layout that keeps the sizes */
+#define PLUGABI 1
+
 typedef struct {
-	char stext[256];
+	char stext[STATUSSEGS][128]; /* status segments, see setstatus() */
 	int screen;
 	int sw, sh;           /* X display screen geometry width, height */
 	int bh;               /* bar height */
 	int lrpad;            /* sum of left and right padding for text */
 	int (*xerrorxlib)(Display *, XErrorEvent *);
 	unsigned int numlockmask;
+	KeyBind *keytab;      /* keypress() lookup, built by grabkeys() */
+	unsigned int keytabcap;
+	GrabSet keygrabs, buttongrabs; /* on the root, see grabset() */
+	RuleIndex rules;      /* rules[] compiled by compilerules() */
+#ifdef TRACE
+	Trace trace;          /* see tracedump() */
+#endif
 	void (*handler[LASTEvent]) (XEvent *);
 	Atom wmatom[WMLast], netatom[NetLast];
 	int running;
+	int batching;         /* run() is dispatching a batch, see drawbar() */
+	int dropenter;        /* restack() asks to skip the batch's EnterNotify */
+	int xfd;              /* X connection, polled by run() */
+	int havesync;         /* the server has the XSync extension */
+	int rrbase;           /* RandR event base, -1 without RandR 1.5 */
+	int ctlpipe[2];       /* self-pipe carrying control messages */
+	int sockfd;           /* control socket, see readsock(), or -1 */
+	char sockpath[108];
+	int tfd;              /* timerfd armed for the earliest timer */
+	Timer timers[MAXTIMERS];
+	int timerslot[MAXTIMERS];
+	int ntimers;
+	int clocktimer;
+	int msgtimer;         /* clears a message shown for the clock, or -1 */
+	time_t clocksec;      /* second shown by the clock */
+	char ctext[64];       /* formatted clock, shaped into crun */
+	Run crun;
+	unsigned int statusgen; /* bumped whenever the status segment changes */
+	unsigned int tagw[32], tagsw; /* tag widths, measured once in setup() */
 	Cur *cursor[CurLast];
 	Clr **scheme;
 	Display *dpy;
@@ -20,6 +51,24 @@ typedef struct {
 	Window root, wmcheckwin;
 	XWindowAttributes mrwa;
 	Monitor *mnmon;
+	Client **wintab;      /* window -> client index, see wintoclient() */
+	unsigned int wintabcap, nwintab;
+	Client *freeclients;  /* pool of clientalloc() */
+	ClientCold *cold;     /* cold parts of all pooled clients */
+	unsigned int ncold, coldcap;
+	Window *clientlist;   /* _NET_CLIENT_LIST in mapping order */
+	unsigned int nclientlist, clientlistcap;
+	int clientlistdirty;  /* clientlist differs from what the root has */
+	Place *place;         /* scratch targets of a layout, see gathertiled() */
+	unsigned int nplace, placecap;
+	unsigned int clientgen; /* bumped on any client change a layout sees */
+	unsigned int stackgen;  /* bumped on any change of a stacking order */
+	Window *stacknew;     /* scratch of restackdiff() */
+	unsigned int stackcap;
 	const char *broken;
-	void *dl;
+	int buildfd;          /* status pipe of the dwm.so build under way, or -1 */
+	void *dl, *olddl;     /* the loaded build and the one it replaced */
+	int reloaded;         /* run() returned for a swap of builds */
+	const Symtab *symtab; /* of the build bound now */
+	void (*bind)(const Symtab *t); /* binds the main binary's pointers */
 } Plug;
@@ -4,6 +4,11 @@
 #define MIN(A, B)               ((A) < (B) ? (A) : (B))
 #define BETWEEN(X, A, B)        ((A) <= (X) && (X) <= (B))
 #define LENGTH(X)               (sizeof (X) / sizeof (X)[0])
+#ifdef EAGERSYNC
+#define XSYNC(D)                XSync((D), False)
+#else
+#define XSYNC(D)                ((void)(D)) /* flushed once per batch in run() */
+#endif
 
 void die(const char *fmt, ...);
 void *ecalloc(size_t nmemb, size_t size);